@@ -34,3 +34,98 @@ TEST_CASE ("Boot performance")
         });
     };
 }
+
+TEST_CASE ("Render performance")
+{
+    constexpr auto sampleRate { 48000.0 };
+    constexpr auto blockSize { 512 };
+
+    juce::MidiBuffer noteOn;
+    for (auto note : { 48, 55, 60, 64 })
+        noteOn.addEvent (juce::MidiMessage::noteOn (1, note, (juce::uint8) 100), 0);
+
+    //the very first block after loading, which used to build the oscillator tables on the audio thread
+    BENCHMARK_ADVANCED ("First note block")
+    (Catch::Benchmark::Chronometer meter)
+    {
+        std::vector<std::unique_ptr<ProPhatProcessor>> plugins;
+        for (int i = 0; i < meter.runs(); ++i)
+        {
+            plugins.push_back (std::make_unique<ProPhatProcessor>());
+            plugins.back()->prepareToPlay (sampleRate, blockSize);
+        }
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        meter.measure ([&] (int i) {
+            auto midi { noteOn };
+            plugins[(size_t) i]->processBlock (buffer, midi);
+            return buffer.getSample (0, 0);
+        });
+    };
+
+    BENCHMARK_ADVANCED ("Steady-state block")
+    (Catch::Benchmark::Chronometer meter)
+    {
+        ProPhatProcessor plugin;
+        plugin.prepareToPlay (sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        auto midi { noteOn };
+        plugin.processBlock (buffer, midi);
+
+        meter.measure ([&] {
+            juce::MidiBuffer noMidi;
+            plugin.processBlock (buffer, noMidi);
+            return buffer.getSample (0, 0);
+        });
+    };
+
+    //the same steady state, with the oscillators and the filter oversampled
+    for (auto oversampling : { 1, 2 })
+    {
+        BENCHMARK_ADVANCED (oversampling == 1 ? "Steady-state block, 2x oversampling" : "Steady-state block, 4x oversampling")
+        (Catch::Benchmark::Chronometer meter)
+        {
+            ProPhatProcessor plugin;
+            plugin.prepareToPlay (sampleRate, blockSize);
+
+            auto* param { plugin.state.getParameter (ProPhatParameterIds::oversamplingID.getParamID ()) };
+            param->setValueNotifyingHost (param->convertTo0to1 ((float) oversampling));
+
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            auto midi { noteOn };
+            plugin.processBlock (buffer, midi);
+
+            meter.measure ([&] {
+                juce::MidiBuffer noMidi;
+                plugin.processBlock (buffer, noMidi);
+                return buffer.getSample (0, 0);
+            });
+        };
+    }
+
+    //a double precision host, served by either engine
+    for (auto engine : { ProPhatProcessor::DoubleHostEngine::doubleEngine, ProPhatProcessor::DoubleHostEngine::floatEngine })
+    {
+        const auto name { engine == ProPhatProcessor::DoubleHostEngine::doubleEngine ? "Double host block, double engine"
+                                                                                    : "Double host block, float engine" };
+        BENCHMARK_ADVANCED (name)
+        (Catch::Benchmark::Chronometer meter)
+        {
+            ProPhatProcessor plugin;
+            plugin.setProcessingPrecision (juce::AudioProcessor::doublePrecision);
+            plugin.setDoubleHostEngine (engine);
+            plugin.prepareToPlay (sampleRate, blockSize);
+
+            juce::AudioBuffer<double> buffer (2, blockSize);
+            auto midi { noteOn };
+            plugin.processBlock (buffer, midi);
+
+            meter.measure ([&] {
+                juce::MidiBuffer noMidi;
+                plugin.processBlock (buffer, noMidi);
+                return buffer.getSample (0, 0);
+            });
+        };
+    }
+}
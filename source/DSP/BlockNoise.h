@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../Utility/Helpers.h"
+#include "../Utility/Macros.h"
+
+/**
+ * @brief White noise in [-1, 1), a block at a time.
+    By default each generator runs 8 interleaved xorshift32 streams, one per SIMD lane, so filling a block is a
+    short loop of shifts and xors the compiler vectorises, instead of a std::uniform_real_distribution call per sample.
+    Generators can also share one precomputed stream, see the constructor.
+*/
+template <std::floating_point T>
+class BlockNoise
+{
+public:
+    /** When sharing, all generators read one process-wide stream of noise, each from its own random position, and
+    *   rendering a block is only a copy. Positions that far apart are uncorrelated, so voices and channels still sound
+    *   independent. The stream loops every few seconds though, which can be heard on long sustained noise.
+    */
+    explicit BlockNoise (bool shouldShareStream = SHARE_NOISE_STREAM)
+    {
+        juce::Random rng;
+        for (auto& state : states)
+            state = static_cast<uint32_t> (rng.nextInt ()) | 1u; //xorshift gets stuck at 0
+
+        if (shouldShareStream)
+        {
+            sharedStream.emplace ();
+            readPosition = static_cast<size_t> (rng.nextInt (static_cast<int> (SharedStream::size)));
+        }
+    }
+
+    /** Adds noise to every channel of the block, with each channel getting different noise. */
+    template <typename Block>
+    void process (const Block& block, T gain = T (1)) noexcept
+    {
+        const auto numSamples { block.getNumSamples () };
+
+        for (size_t c = 0; c < block.getNumChannels (); ++c)
+        {
+            auto* channel { block.getChannelPointer (c) };
+
+            if (sharedStream.has_value ())
+                addShared (channel, numSamples, c, gain);
+            else
+                addGenerated (channel, numSamples, gain);
+        }
+
+        if (sharedStream.has_value ())
+            readPosition = (readPosition + numSamples) % SharedStream::size;
+    }
+
+private:
+    static constexpr size_t numLanes { 8 };
+    static constexpr size_t chunkSize { (size_t) Constants::processingQuantum };
+
+    //a 32-bit state mapped to [-1, 1)
+    static constexpr T scale { T (1) / T (2147483648.) };
+
+    /** Runs all the lanes for as many samples as fit in dest, which must be a multiple of numLanes long. */
+    static void fill (std::array<uint32_t, numLanes>& laneStates, T* dest, size_t num) noexcept
+    {
+        jassert (num % numLanes == 0);
+
+        for (size_t i = 0; i < num; i += numLanes)
+        {
+            for (size_t l = 0; l < numLanes; ++l)
+            {
+                auto x { laneStates[l] };
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                laneStates[l] = x;
+
+                dest[i + l] = static_cast<T> (static_cast<int32_t> (x)) * scale;
+            }
+        }
+    }
+
+    void addGenerated (T* channel, size_t numSamples, T gain) noexcept
+    {
+        alignas (64) std::array<T, chunkSize> samples;
+
+        for (size_t start = 0; start < numSamples; start += chunkSize)
+        {
+            const auto num { juce::jmin (chunkSize, numSamples - start) };
+
+            //always generate whole lanes, the extra samples of a short chunk are simply dropped
+            fill (states, samples.data (), (num + numLanes - 1) / numLanes * numLanes);
+            juce::FloatVectorOperations::addWithMultiply (channel + start, samples.data (), gain, (int) num);
+        }
+    }
+
+    /** The process-wide stream, generated once by the same xorshift lanes. */
+    struct SharedStream
+    {
+        //about 2.7 seconds at 48 kHz
+        static constexpr size_t size { 1 << 17 };
+
+        SharedStream () : samples (size)
+        {
+            std::array<uint32_t, numLanes> laneStates;
+            for (size_t l = 0; l < numLanes; ++l)
+                laneStates[l] = 0x9e3779b9u * static_cast<uint32_t> (l + 1);
+
+            fill (laneStates, samples.data (), size);
+        }
+
+        std::vector<T> samples;
+    };
+
+    void addShared (T* channel, size_t numSamples, size_t channelIndex, T gain) noexcept
+    {
+        const auto& samples { (*sharedStream)->samples };
+
+        //each channel reads half the stream further, plus a bit so more than 2 channels don't line up
+        auto position { (readPosition + channelIndex * (SharedStream::size / 2 + 4099)) % SharedStream::size };
+
+        while (numSamples > 0)
+        {
+            const auto num { juce::jmin (numSamples, SharedStream::size - position) };
+            juce::FloatVectorOperations::addWithMultiply (channel, samples.data () + position, gain, (int) num);
+
+            channel += num;
+            numSamples -= num;
+            position = 0;
+        }
+    }
+
+    std::array<uint32_t, numLanes> states;
+
+    std::optional<juce::SharedResourcePointer<SharedStream>> sharedStream;
+    size_t readPosition { 0 };
+};
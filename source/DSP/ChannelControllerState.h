@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../Utility/FastMath.h"
+#include "../Utility/Helpers.h"
+
+/** The continuous controller state of one midi channel. ProPhatSynthesiser updates it once per midi event,
+*   and every voice playing on that channel reads the precomputed values at its next control tick, instead
+*   of each voice redoing the same math for every event.
+*/
+struct ChannelControllerState
+{
+    void setPitchWheel (int newPosition)
+    {
+        pitchWheelPosition = newPosition;
+
+        const auto pitchWheelDeltaNote = Constants::pitchWheelNoteRange.convertFrom0to1 (newPosition / 16383.f);
+        pitchWheelRatio = FastMath::exp2 (pitchWheelDeltaNote / 12.f);
+    }
+
+    //CC1, which is the orba tilt
+    void setModWheel (int newValue)
+    {
+        modWheel = newValue / 127.f;
+        modWheelMoved = true;
+    }
+
+    int pitchWheelPosition = 8192;
+
+    /** Frequency ratio for the current pitch wheel position. */
+    float pitchWheelRatio = 1.f;
+
+    /** CC1 value normalised to [0, 1]. */
+    float modWheel = 0.f;
+
+    /** False until the first CC1 on this channel, the tilt doesn't move the cutoff before that. */
+    bool modWheelMoved = false;
+};
+
+using ChannelControllerStates = std::array<ChannelControllerState, 16>;
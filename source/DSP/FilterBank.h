@@ -0,0 +1,493 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../Utility/FastMath.h"
+#include "../Utility/Helpers.h"
+#include <numbers>
+
+/** The filters a FilterBank can run, as policies: whether they're linear, the coefficients for a cutoff and a
+    resonance, and a kernel that runs a block through all the lanes. For each sample, the kernels only loop over fixed-size lane arrays, so they
+    vectorise. The smoothed coefficients of each sample and lane come from ramps.
+*/
+namespace FilterTopology
+{
+/** juce::dsp::LadderFilter's lowpass with its default drive, taking its output after 2 or 4 of its stages. */
+template <size_t numPoles>
+struct Ladder
+{
+    static_assert (numPoles == 2 || numPoles == 4);
+
+    //the drive saturates the oscillators even when the filter is fully open
+    static constexpr bool isLinear { false };
+
+    template <std::floating_point T>
+    static T getCutoffCoefficient (T cutoffHz, double sampleRate)
+    {
+        //e^(-2 pi fc / fs), as a power of 2
+        return FastMath::exp2 (static_cast<T> (-2.0 * juce::MathConstants<double>::pi * std::numbers::log2e * cutoffHz / sampleRate));
+    }
+
+    template <std::floating_point T>
+    static T getResonanceCoefficient (T resonance) { return juce::jmap (resonance, T (.1), T (1)); }
+
+    template <typename Lanes, typename Ramps>
+    static void process (std::array<Lanes, 5>& state, const Ramps& rampsIn, Lanes* samples, size_t numSamples) noexcept
+    {
+        //working on local copies lets the compiler see they don't alias the samples, so the lane loops vectorise
+        const auto ramps { rampsIn };
+        auto s { state };
+        using T = typename Lanes::value_type;
+        static constexpr auto numLanes { std::tuple_size_v<Lanes> };
+
+        static constexpr T drive { T (1.2) }, drive2 { drive * T (.04) + T (.96) }, comp { T (.5) }, outputGain { T (1.2) };
+        const auto gain { std::pow (drive, T (-2.642)) * T (.6103) + T (.3903) };
+        const auto gain2 { std::pow (drive2, T (-2.642)) * T (.6103) + T (.3903) };
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            //the saturations are vectorised in loops of their own
+            alignas (32) Lanes input, feedback;
+            for (size_t lane = 0; lane < numLanes; ++lane)
+                input[lane] = gain * FastMath::tanh (drive * samples[i][lane]);
+
+            for (size_t lane = 0; lane < numLanes; ++lane)
+                feedback[lane] = gain2 * FastMath::tanh (drive2 * s[4][lane]);
+
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                const auto a1 { ramps.getCutoff (i, lane) };
+                const auto g { T (1) - a1 };
+                const auto b0 { g * T (0.76923076923) };
+                const auto b1 { g * T (0.23076923076) };
+
+                const auto dx { input[lane] };
+                const auto a { dx + ramps.getResonance (i, lane) * T (-4) * (feedback[lane] - dx * comp) };
+
+                const auto b { b1 * s[0][lane] + a1 * s[1][lane] + b0 * a };
+                const auto c { b1 * s[1][lane] + a1 * s[2][lane] + b0 * b };
+                const auto d { b1 * s[2][lane] + a1 * s[3][lane] + b0 * c };
+                const auto e { b1 * s[3][lane] + a1 * s[4][lane] + b0 * d };
+
+                s[0][lane] = a;
+                s[1][lane] = b;
+                s[2][lane] = c;
+                s[3][lane] = d;
+                s[4][lane] = e;
+
+                samples[i][lane] = (numPoles == 2 ? c : e) * outputGain;
+            }
+        }
+
+        state = s;
+    }
+};
+
+/** Andrew Simper's zero-delay feedback state variable lowpass. It's linear, so it's cleaner and cheaper than the
+    ladder, and its resonance goes from a Q of .5 to 25.
+*/
+struct StateVariable
+{
+    static constexpr bool isLinear { true };
+
+    template <std::floating_point T>
+    static T getCutoffCoefficient (T cutoffHz, double sampleRate)
+    {
+        //the prewarping goes to infinity at nyquist
+        return static_cast<T> (std::tan (juce::MathConstants<double>::pi * juce::jmin (double (cutoffHz), .49 * sampleRate) / sampleRate));
+    }
+
+    template <std::floating_point T>
+    static T getResonanceCoefficient (T resonance) { return T (2) * (T (1) - T (.98) * resonance); }
+
+    template <typename Lanes, typename Ramps>
+    static void process (std::array<Lanes, 5>& state, const Ramps& rampsIn, Lanes* samples, size_t numSamples) noexcept
+    {
+        const auto ramps { rampsIn };
+        auto s { state };
+        using T = typename Lanes::value_type;
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            for (size_t lane = 0; lane < std::tuple_size_v<Lanes>; ++lane)
+            {
+                const auto g { ramps.getCutoff (i, lane) };
+                const auto a1 { T (1) / (T (1) + g * (g + ramps.getResonance (i, lane))) };
+                const auto a2 { g * a1 };
+                const auto a3 { g * a2 };
+
+                const auto v3 { samples[i][lane] - s[1][lane] };
+                const auto v1 { a1 * s[0][lane] + a2 * v3 };
+                const auto v2 { s[1][lane] + a2 * s[0][lane] + a3 * v3 };
+
+                s[0][lane] = T (2) * v1 - s[0][lane];
+                s[1][lane] = T (2) * v2 - s[1][lane];
+                samples[i][lane] = v2;
+            }
+        }
+
+        state = s;
+    }
+};
+
+/** A single 6 dB/octave pole, with no resonance. The cheapest of them all, for patches that barely use the filter. */
+struct OnePole
+{
+    static constexpr bool isLinear { true };
+
+    template <std::floating_point T>
+    static T getCutoffCoefficient (T cutoffHz, double sampleRate) { return Ladder<2>::getCutoffCoefficient (cutoffHz, sampleRate); }
+
+    template <std::floating_point T>
+    static T getResonanceCoefficient (T) { return T (0); }
+
+    template <typename Lanes, typename Ramps>
+    static void process (std::array<Lanes, 5>& state, const Ramps& rampsIn, Lanes* samples, size_t numSamples) noexcept
+    {
+        const auto ramps { rampsIn };
+        auto s { state };
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            for (size_t lane = 0; lane < std::tuple_size_v<Lanes>; ++lane)
+            {
+                s[0][lane] = samples[i][lane] + ramps.getCutoff (i, lane) * (s[0][lane] - samples[i][lane]);
+                samples[i][lane] = s[0][lane];
+            }
+        }
+
+        state = s;
+    }
+};
+
+/** Calls function with the policy of a FilterType, so it's instantiated for each topology and picked once per call. */
+template <typename Function>
+auto withTopology (int filterType, Function&& function)
+{
+    switch (filterType)
+    {
+        case FilterType::ladder4Pole:   return function (Ladder<4> {});
+        case FilterType::stateVariable: return function (StateVariable {});
+        case FilterType::onePole:       return function (OnePole {});
+        case FilterType::ladder2Pole:
+        default:                        return function (Ladder<2> {});
+    }
+}
+}
+
+//=====================================================================================================================
+
+template <std::floating_point T> class FilterBank;
+
+/**
+ * @brief A lowpass filter of any of the FilterType topologies, run through a FilterBank, so the channels of many of
+    them can be processed together in SIMD lanes.
+*/
+template <std::floating_point T>
+class ProPhatFilter
+{
+public:
+    static constexpr size_t maxChannels { 2 };
+
+    ProPhatFilter ()
+    {
+        setCutoffFrequencyHz (cutoffHz);
+        setResonance (0);
+    }
+
+    /** Recomputes the coefficients for the spec's sample rate, and starts again from silence. */
+    void prepare (const juce::dsp::ProcessSpec& spec) noexcept
+    {
+        jassert (spec.numChannels <= maxChannels);
+        numChannels = spec.numChannels;
+        sampleRate = spec.sampleRate;
+        smoothingSteps = (int) std::floor (smoothingSeconds * spec.sampleRate);
+
+        reset ();
+    }
+
+    /** Starts again from silence, with the coefficients where they were going. */
+    void reset () noexcept
+    {
+        for (auto& channel : channels)
+        {
+            channel.state.fill (0);
+            channel.cutoff.setCurrentAndTarget (getCutoffCoefficient ());
+            channel.resonance.setCurrentAndTarget (getResonanceCoefficient ());
+        }
+    }
+
+    /** Switches to another FilterType, starting again from silence. */
+    void setType (int newType) noexcept
+    {
+        jassert (newType >= 0 && newType < FilterType::totalSelectable);
+        type = newType;
+
+        reset ();
+    }
+
+    int getType () const noexcept { return type; }
+
+    /** True when a FilterType only filters, so it's transparent when fully open without resonance. */
+    static bool isLinear (int filterType) noexcept
+    {
+        return FilterTopology::withTopology (filterType, [] (auto topology) { return decltype (topology)::isLinear; });
+    }
+
+    void setCutoffFrequencyHz (T newCutoff) noexcept
+    {
+        jassert (newCutoff > 0);
+        cutoffHz = newCutoff;
+
+        for (auto& channel : channels)
+            channel.cutoff.setTarget (getCutoffCoefficient (), smoothingSteps);
+    }
+
+    void setResonance (T newResonance) noexcept
+    {
+        jassert (newResonance >= 0 && newResonance <= 1);
+        resonance = newResonance;
+
+        for (auto& channel : channels)
+            channel.resonance.setTarget (getResonanceCoefficient (), smoothingSteps);
+    }
+
+    /** Filters the block in place, on its own. See FilterBank to filter it along with other blocks. */
+    void process (const juce::dsp::AudioBlock<T>& block) noexcept;
+
+private:
+    friend class FilterBank<T>;
+
+    /** A linear ramp like juce::SmoothedValue's, which FilterBank advances a whole block at a time. */
+    struct Smoother
+    {
+        void setCurrentAndTarget (T value) noexcept
+        {
+            current = target = value;
+            stepsLeft = 0;
+        }
+
+        void setTarget (T value, int steps) noexcept
+        {
+            if (value == target)
+                return;
+
+            if (steps <= 0)
+                return setCurrentAndTarget (value);
+
+            target = value;
+            stepsLeft = steps;
+            step = (target - current) / T (steps);
+        }
+
+        void skip (int numSteps) noexcept
+        {
+            if (numSteps >= stepsLeft)
+                return setCurrentAndTarget (target);
+
+            current += step * T (numSteps);
+            stepsLeft -= numSteps;
+        }
+
+        T current { 0 }, target { 0 }, step { 0 };
+        int stepsLeft = 0;
+    };
+
+    struct Channel
+    {
+        std::array<T, 5> state {};
+        Smoother cutoff, resonance;
+    };
+
+    T getCutoffCoefficient () const
+    {
+        return FilterTopology::withTopology (type, [this] (auto topology) { return decltype (topology)::getCutoffCoefficient (cutoffHz, sampleRate); });
+    }
+
+    T getResonanceCoefficient () const
+    {
+        return FilterTopology::withTopology (type, [this] (auto topology) { return decltype (topology)::getResonanceCoefficient (resonance); });
+    }
+
+    static constexpr double smoothingSeconds { .05 };
+
+    std::array<Channel, maxChannels> channels;
+    size_t numChannels = maxChannels;
+    int type = Constants::defaultFilterType;
+    T cutoffHz { 200 }, resonance { 0 };
+    double sampleRate = 44100.;
+    int smoothingSteps = 0;
+};
+
+//=====================================================================================================================
+
+/**
+ * @brief Runs the channels of many ProPhatFilter at once, each of them in a lane of fixed-size arrays, so the compiler
+    can run numLanes of them in a single pass of SIMD instructions. Blocks are queued with add(), grouped by length
+    and filter type, and a group is processed as soon as it fills up, or at the latest in flush().
+*/
+template <std::floating_point T>
+class FilterBank
+{
+public:
+    /** 8 floats or 4 doubles, ie one AVX register */
+    static constexpr size_t numLanes { 32 / sizeof (T) };
+
+    //blocks are at most a quantum at the highest oversampling factor
+    static constexpr size_t maxSamples { (size_t) (Constants::processingQuantum * Constants::maxOversamplingFactor) };
+
+    FilterBank () = default;
+    ~FilterBank () { jassert (std::all_of (groups.begin (), groups.end (), [] (const Group& g) { return g.numUsed == 0; })); }
+
+    /** Queues the channels of block to be filtered in place by filter. The block must stay valid until flush(). */
+    void add (ProPhatFilter<T>& filter, const juce::dsp::AudioBlock<T>& block) noexcept
+    {
+        jassert (block.getNumChannels () <= filter.numChannels && block.getNumSamples () <= maxSamples);
+
+        for (size_t c = 0; c < block.getNumChannels (); ++c)
+        {
+            auto& group { getGroup (block.getNumSamples (), filter.type) };
+            group.lanes[group.numUsed++] = { block.getChannelPointer (c), &filter.channels[c] };
+
+            if (group.numUsed == numLanes)
+                process (group);
+        }
+    }
+
+    /** Processes all the blocks still queued. */
+    void flush () noexcept
+    {
+        for (auto& group : groups)
+            if (group.numUsed > 0)
+                process (group);
+    }
+
+private:
+    using Lanes = std::array<T, numLanes>;
+
+    /** The smoothed coefficients of each lane, like ProPhatFilter::Smoother, which stop on their last step. */
+    struct Ramps
+    {
+        T getCutoff (size_t i, size_t lane) const noexcept { return cutoff[lane] + cutoffStep[lane] * std::min (T (i + 1), cutoffSteps[lane]); }
+        T getResonance (size_t i, size_t lane) const noexcept { return resonance[lane] + resonanceStep[lane] * std::min (T (i + 1), resonanceSteps[lane]); }
+
+        alignas (32) Lanes cutoff {}, cutoffStep {}, cutoffSteps {}, resonance {}, resonanceStep {}, resonanceSteps {};
+    };
+
+    struct Lane
+    {
+        T* samples = nullptr;
+        typename ProPhatFilter<T>::Channel* channel = nullptr;
+    };
+
+    struct Group
+    {
+        std::array<Lane, numLanes> lanes {};
+        size_t numUsed = 0, numSamples = 0;
+        int type = 0;
+    };
+
+    //the 3 block lengths of the oversampling factors, for the filter types voices crossfade between
+    std::array<Group, 6> groups {};
+
+    Group& getGroup (size_t numSamples, int type) noexcept
+    {
+        for (auto& group : groups)
+            if (group.numUsed > 0 && group.numSamples == numSamples && group.type == type)
+                return group;
+
+        auto& group { *std::min_element (groups.begin (), groups.end (), [] (const Group& a, const Group& b) { return a.numUsed < b.numUsed; }) };
+
+        //they're all taken, so make room
+        if (group.numUsed > 0)
+            process (group);
+
+        group.numSamples = numSamples;
+        group.type = type;
+        return group;
+    }
+
+    void process (Group& group) noexcept
+    {
+        FilterTopology::withTopology (group.type, [this, &group] (auto topology) { run<decltype (topology)> (group); });
+        group.numUsed = 0;
+    }
+
+    template <typename Topology>
+    void run (const Group& group) noexcept
+    {
+        //the unused lanes run on silence, which keeps the trip counts constant
+        alignas (32) std::array<Lanes, 5> s {};
+        alignas (32) std::array<Lanes, maxSamples> samples;
+        Ramps ramps;
+
+        const auto numSamples { group.numSamples };
+        for (size_t lane = 0; lane < numLanes; ++lane)
+        {
+            if (lane < group.numUsed)
+            {
+                const auto& [laneSamples, channel] { group.lanes[lane] };
+
+                for (size_t i = 0; i < numSamples; ++i)
+                    samples[i][lane] = laneSamples[i];
+
+                for (size_t k = 0; k < s.size (); ++k)
+                    s[k][lane] = channel->state[k];
+
+                ramps.cutoff[lane] = channel->cutoff.current;
+                ramps.cutoffStep[lane] = channel->cutoff.step;
+                ramps.cutoffSteps[lane] = T (channel->cutoff.stepsLeft);
+                ramps.resonance[lane] = channel->resonance.current;
+                ramps.resonanceStep[lane] = channel->resonance.step;
+                ramps.resonanceSteps[lane] = T (channel->resonance.stepsLeft);
+            }
+            else
+            {
+                for (size_t i = 0; i < numSamples; ++i)
+                    samples[i][lane] = 0;
+            }
+        }
+
+        Topology::process (s, ramps, samples.data (), numSamples);
+
+        for (size_t lane = 0; lane < group.numUsed; ++lane)
+        {
+            const auto& [laneSamples, channel] { group.lanes[lane] };
+
+            for (size_t i = 0; i < numSamples; ++i)
+                laneSamples[i] = samples[i][lane];
+
+            for (size_t k = 0; k < s.size (); ++k)
+                channel->state[k] = s[k][lane];
+
+            channel->cutoff.skip ((int) numSamples);
+            channel->resonance.skip ((int) numSamples);
+        }
+    }
+};
+
+template <std::floating_point T>
+void ProPhatFilter<T>::process (const juce::dsp::AudioBlock<T>& block) noexcept
+{
+    FilterBank<T> bank;
+    bank.add (*this, block);
+    bank.flush ();
+}
@@ -21,16 +21,24 @@
 */
 
 #pragma once
+#include "BlockNoise.h"
+#include "ProPhatOscillator.h"
+#include "UnisonOscillator.h"
 #include "../Utility/Helpers.h"
-#include <random>
+#include "../Utility/Macros.h"
 
 template <std::floating_point T>
 class GainedOscillator
 {
 public:
-    GainedOscillator () :
-        distribution ((T) -1, (T) 1)
+    GainedOscillator ()
     {
+        //the periodic shapes are band-limited in ProPhatOscillator and noise is rendered by BlockNoise, only silence
+        //needs a generator. It's built here and the wavetables are shared from prepare(), so switching shapes on the audio thread never builds anything
+        silenceGenerator = [] (T /*x*/) { return T (0); };
+
+        oscillator.initialise (silenceGenerator);
+
         setOscShape (OscShape::saw);
         setGain (Constants::defaultOscLevel);
     }
@@ -39,62 +47,91 @@ public:
     {
         jassert (newValue > 0);
 
-        auto& osc = processorChain.template get<oscIndex> ();
-        osc.setFrequency (newValue, force);
+        oscillator.setFrequency (newValue, force);
+    }
+
+    /** With more than one voice, the oscillator is rendered as a detuned stereo stack, see UnisonOscillator. */
+    void setUnison (int numVoices, float detune, float spread)
+    {
+        unison.setNumVoices (numVoices);
+        unison.setDetune (detune);
+        unison.setSpread (spread);
     }
 
     void setOscShape (OscShape::Values newShape) { nextOsc.store (newShape); }
 
-    /**
-     * @brief Sets the gain for the oscillator in the processorChain.
-        This ends up calling juce::dsp::Gain::setGainLinear(), which will ramp the change.
-        The newGain is also cached in lastActiveGain, so we can recall that value if the
-        oscillator is deactivated and reactivated.
+    /** Sets the level of the oscillator. The kernels apply it while they mix, see PhatOscillators::processStages(). */
+    void setGain (T newGain) { gain = newGain; }
+
+    T getGain () const { return gain; }
+
+    /** False when this oscillator cannot contribute anything, ie its shape is none or its gain is 0.
+    *   This looks at the pending shape, so an oscillator that is skipped still gets re-enabled.
     */
-    void setGain (T newGain)
-    {
-        if (! isActive)
-            newGain = 0;
-        else
-            lastActiveGain = newGain;
+    bool isAudible () const { return nextOsc.load () != OscShape::none && gain != T (0); }
 
-        auto& gain = processorChain.template get<gainIndex> ();
-        gain.setGainLinear (newGain);
+    /** For kernels rendering several oscillators at once, see PhatOscillators::processStages(). This applies a pending
+    *   shape change, and returns the oscillator so its phases and shape can be computed alongside the other ones.
+    *   Its gain isn't applied, see getGain().
+    */
+    ProPhatOscillator<T>& getUpdatedOscillator ()
+    {
+        updateOscillators ();
+        return oscillator;
     }
 
-    T getGain () { return lastActiveGain; }
+    /** True when the oscillator is rendered as a unison stack, see addStack(). */
+    bool isStacked () const { return unison.getNumVoices () > 1; }
 
-    void reset () noexcept { processorChain.reset (); }
+    /** Adds the unison stack to the block, scaled by gain. The stack follows the oscillator's frequency ramp, from
+    *   startFrequency to where the ramp is at, so the ramp must have been moved on over the block first.
+    */
+    void addStack (const juce::dsp::AudioBlock<T>& block, T stackGain, T startFrequency)
+    {
+        unison.process (block, currentOsc.load (), startFrequency, oscillator.getCurrentFrequency (), stackGain);
+    }
 
-    template <typename ProcessContext>
-    void process (const ProcessContext& context) noexcept
+    /** Adds our noise to the block, scaled by gain. */
+    void addNoise (const juce::dsp::AudioBlock<T>& block, T noiseGain) { blockNoise.process (block, noiseGain); }
+
+    void prepare (const juce::dsp::ProcessSpec& spec)
     {
-        updateOscillators();
+#if USE_WAVETABLE_OSCILLATORS
+        //only the engine that gets prepared needs wavetables of its sample type, so the bank is built on first use here
+        if (! waveformBank.has_value ())
+            waveformBank.emplace ();
+#endif
 
-        processorChain.process (context);
-    }
+        oscillator.prepare (spec);
+        unison.prepare (spec.sampleRate);
 
-    void prepare (const juce::dsp::ProcessSpec& spec) { processorChain.prepare (spec); }
+        //apply the shape now rather than on the first render
+        updateOscillators ();
+    }
 
-private:
-    enum
+    /** Moves to a new sample rate between 2 blocks, keeping the phase, see ProPhatOscillator::setSampleRate(). */
+    void setSampleRate (double newSampleRate)
     {
-        oscIndex,
-        gainIndex
-    };
+        oscillator.setSampleRate (newSampleRate);
+        unison.prepare (newSampleRate);
+    }
 
+private:
     std::atomic<OscShape::Values> currentOsc { OscShape::none }, nextOsc { { OscShape::saw } };
 
     void updateOscillators();
 
-    bool isActive = true;
+    ProPhatOscillator<T> oscillator;
+    T gain {};
 
-    T lastActiveGain {};
+    UnisonOscillator<T> unison;
 
-    juce::dsp::ProcessorChain<juce::dsp::Oscillator<T>, juce::dsp::Gain<T>> processorChain;
+    std::function<T (T)> silenceGenerator;
+    BlockNoise<T> blockNoise;
 
-    std::uniform_real_distribution<T> distribution;
-    std::default_random_engine generator;
+#if USE_WAVETABLE_OSCILLATORS
+    std::optional<juce::SharedResourcePointer<OscillatorWaveformBank<T>>> waveformBank;
+#endif
 };
 
 //====================================================================================================
@@ -107,88 +144,22 @@ void GainedOscillator<T>::updateOscillators()
     if (currentOsc == nextOscBuf)
         return;
 
-    //this is to make sure we preserve the same gain after we re-init, right?
-    bool wasActive = isActive;
-    isActive = true;
+    jassert (nextOscBuf != OscShape::totalSelectable);
 
-    auto& osc = processorChain.template get<oscIndex>();
     switch (nextOscBuf)
     {
-    case OscShape::none:
-        osc.initialise ([&] (T /*x*/) { return T (0); });
-        isActive = false;
-        break;
-
-    case OscShape::saw:
-    {
-        osc.initialise ([](T x)
-                        {
-                            //this is a sawtooth wave; as x goes from -pi to pi, y goes from -1 to 1
-                            return juce::jmap (x, T (-juce::MathConstants<double>::pi), T (juce::MathConstants<double>::pi), T (-1), T (1));
-                        }, 2);
-    }
-    break;
-
-    case OscShape::sawTri:
-    {
-        osc.initialise ([](T x)
-                        {
-                            T y = juce::jmap (x, T (-juce::MathConstants<double>::pi), T (juce::MathConstants<double>::pi), T (-1), T (1)) / 2;
-
-                            if (x < 0)
-                                return y += juce::jmap (x, T (-juce::MathConstants<double>::pi), T (0), T (-1), T (1)) / 2;
-                            else
-                                return y += juce::jmap (x, T (0), T (juce::MathConstants<double>::pi), T (1), T (-1)) / 2;
-
-                        }, 128);
-    }
-    break;
-
-    case OscShape::triangle:
-    {
-        osc.initialise ([](T x)
-                        {
-                            if (x < 0)
-                                return juce::jmap (x, T (-juce::MathConstants<double>::pi), T (0), T (-1), T (1));
-                            else
-                                return juce::jmap (x, T (0), T (juce::MathConstants<double>::pi), T (1), T (-1));
-
-                        }, 128);
-    }
-    break;
-
-    case OscShape::pulse:
-    {
-        osc.initialise ([](T x)
-                        {
-                            if (x < 0)
-                                return T (-1);
-                            else
-                                return T (1);
-                        }, 128);
-    }
-    break;
-
-    case OscShape::noise:
-    {
-        osc.initialise ([&](T /*x*/)
-                        {
-                            return distribution (generator);
-                        });
-    }
-    break;
-
-    default:
-        jassertfalse;
-        break;
-    }
-
-    if (wasActive != isActive)
-    {
-        if (isActive)
-            setGain (lastActiveGain);
-        else
-            setGain (0);
+        case OscShape::none:
+        case OscShape::noise:
+            oscillator.initialise (silenceGenerator);
+            break;
+        default:
+#if USE_WAVETABLE_OSCILLATORS
+            jassert (waveformBank.has_value ());
+            oscillator.setWavetable ((*waveformBank)->getWavetable (nextOscBuf));
+#else
+            oscillator.setBandLimitedShape (nextOscBuf);
+#endif
+            break;
     }
 
     currentOsc.store (nextOscBuf);
@@ -0,0 +1,227 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../Utility/Helpers.h"
+
+/** Our half-band filters, designed like HIIR does for a given number of coefficients and transition band. */
+namespace HalfBandCoefficients
+{
+//passband up to .21 of the high rate, ie 18.5 kHz at 44.1 kHz, and at least 99 dB of rejection from .29 up
+constexpr std::array<double, 8> steep { .040633460924, .150505129023, .300757055992, .460774504961,
+                                        .609524314896, .738503841119, .849223810392, .949742783705 };
+
+//for the step between 2 and 4 times the sample rate, where only what the steep one lets through matters:
+//passband up to .11 of the high rate, and at least 120 dB of rejection from .39 up
+constexpr std::array<double, 6> wide { .030945968379, .119247253360, .253828968135, .423209290528, .622393356656, .859349378184 };
+}
+
+/**
+ * @brief One 2:1 step of decimation, or 1:2 step of interpolation, through a polyphase half-band IIR filter.
+    The filter is 2 chains of first order allpass sections, one fed the even input samples and the other the odd ones,
+    so each section runs at the low rate. It's the same structure and design as Laurent de Soras' HIIR library.
+    The 2 chains of up to 2 channels always run together: each of them is a lane in fixed-size arrays, so the
+    inner loop has a constant trip count and the compiler can keep all 4 lanes in a single SIMD register.
+*/
+template <std::floating_point T, size_t numCoefs>
+class HalfBandStage
+{
+public:
+    static_assert (numCoefs % 2 == 0, "both chains need the same number of sections");
+
+    explicit HalfBandStage (const std::array<double, numCoefs>& coefs)
+    {
+        //the lanes are {channel 0 even chain, channel 0 odd chain, channel 1 even chain, channel 1 odd chain}
+        for (size_t s = 0; s < numSections; ++s)
+            for (size_t lane = 0; lane < numLanes; ++lane)
+                laneCoefs[s][lane] = static_cast<T> (coefs[2 * s + lane % 2]);
+    }
+
+    void reset () noexcept
+    {
+        for (auto& section : inputs)
+            section.fill (0);
+
+        for (auto& section : outputs)
+            section.fill (0);
+    }
+
+    /** Replaces the first half of the first 2 channels with the other samples of the whole block, filtered.
+    *   The block must hold an even number of samples.
+    */
+    template <typename Block>
+    void decimate (const Block& block) noexcept
+    {
+        jassert (block.getNumChannels () <= 2 && block.getNumSamples () % 2 == 0);
+
+        auto* left { block.getChannelPointer (0) };
+        auto* right { block.getNumChannels () > 1 ? block.getChannelPointer (1) : left };
+
+        for (size_t i = 0; i < block.getNumSamples () / 2; ++i)
+        {
+            //the even chain gets the odd sample, which is the same as delaying the odd chain by one sample
+            alignas (16) std::array<T, numLanes> x { left[2 * i + 1], left[2 * i], right[2 * i + 1], right[2 * i] };
+
+            for (size_t s = 0; s < numSections; ++s)
+            {
+                for (size_t lane = 0; lane < numLanes; ++lane)
+                {
+                    const auto y { laneCoefs[s][lane] * (x[lane] - outputs[s][lane]) + inputs[s][lane] };
+                    inputs[s][lane] = x[lane];
+                    outputs[s][lane] = y;
+                    x[lane] = y;
+                }
+            }
+
+            //writing sample i only ever overwrites samples we already read
+            left[i] = T (.5) * (x[0] + x[1]);
+            right[i] = T (.5) * (x[2] + x[3]);
+        }
+    }
+
+    /** Writes the first 2 channels of input, at twice the rate, to output, which must hold twice as many samples.
+    *   The input can be the second half of the output.
+    */
+    template <typename Block>
+    void interpolate (const Block& input, const Block& output) noexcept
+    {
+        jassert (input.getNumChannels () <= 2 && output.getNumSamples () == 2 * input.getNumSamples ());
+
+        const auto* inLeft { input.getChannelPointer (0) };
+        const auto* inRight { input.getNumChannels () > 1 ? input.getChannelPointer (1) : inLeft };
+        auto* outLeft { output.getChannelPointer (0) };
+        auto* outRight { output.getNumChannels () > 1 ? output.getChannelPointer (1) : outLeft };
+
+        for (size_t i = 0; i < input.getNumSamples (); ++i)
+        {
+            //both chains get every sample, and each of them makes one of the 2 output samples
+            alignas (16) std::array<T, numLanes> x { inLeft[i], inLeft[i], inRight[i], inRight[i] };
+
+            for (size_t s = 0; s < numSections; ++s)
+            {
+                for (size_t lane = 0; lane < numLanes; ++lane)
+                {
+                    const auto y { laneCoefs[s][lane] * (x[lane] - outputs[s][lane]) + inputs[s][lane] };
+                    inputs[s][lane] = x[lane];
+                    outputs[s][lane] = y;
+                    x[lane] = y;
+                }
+            }
+
+            outLeft[2 * i] = x[0];
+            outLeft[2 * i + 1] = x[1];
+            outRight[2 * i] = x[2];
+            outRight[2 * i + 1] = x[3];
+        }
+    }
+
+private:
+    static constexpr size_t numLanes { 4 };
+    static constexpr size_t numSections { numCoefs / 2 };
+
+    alignas (16) std::array<std::array<T, numLanes>, numSections> laneCoefs {}, inputs {}, outputs {};
+};
+
+//====================================================================================================
+
+/**
+ * @brief Brings a block rendered at 2 or 4 times the sample rate back down to it, in place.
+    There is no matching upsampler, because everything we oversample is generated at the high rate in the first place.
+*/
+template <std::floating_point T>
+class HalfBandDecimator
+{
+public:
+    void reset () noexcept
+    {
+        firstStage.reset ();
+        lastStage.reset ();
+    }
+
+    /** Decimates the factor * numSamples samples of block, and returns the numSamples at the start of it. */
+    template <typename Block>
+    Block process (const Block& block, int factor) noexcept
+    {
+        jassert (factor == 1 || factor == 2 || factor == 4);
+
+        if (factor == 4)
+            firstStage.decimate (block);
+
+        const auto numSamples { block.getNumSamples () / (size_t) factor };
+        if (factor > 1)
+            lastStage.decimate (block.getSubBlock (0, numSamples * 2));
+
+        return block.getSubBlock (0, numSamples);
+    }
+
+private:
+    //the first stage only needs to keep what the last one lets through, so its transition band can be much wider
+    HalfBandStage<T, 6> firstStage { HalfBandCoefficients::wide };
+    HalfBandStage<T, 8> lastStage { HalfBandCoefficients::steep };
+};
+
+//====================================================================================================
+
+/**
+ * @brief Takes a block up to 2 or 4 times its sample rate, with the same filters as HalfBandDecimator in reverse order.
+*/
+template <std::floating_point T>
+class HalfBandInterpolator
+{
+public:
+    void reset () noexcept
+    {
+        firstStage.reset ();
+        lastStage.reset ();
+    }
+
+    /** Writes input, upsampled by factor, to the start of output, which must hold factor times as many samples.
+    *   The input and output can't overlap.
+    */
+    template <typename Block>
+    void process (const Block& input, const Block& output, int factor) noexcept
+    {
+        jassert (factor == 1 || factor == 2 || factor == 4);
+
+        const auto numSamples { input.getNumSamples () };
+
+        if (factor == 1)
+        {
+            output.getSubBlock (0, numSamples).copyFrom (input);
+        }
+        else if (factor == 2)
+        {
+            firstStage.interpolate (input, output.getSubBlock (0, 2 * numSamples));
+        }
+        else
+        {
+            //the intermediate rate goes in the second half, so the last stage can write over it from the start
+            const auto halfway { output.getSubBlock (2 * numSamples, 2 * numSamples) };
+            firstStage.interpolate (input, halfway);
+            lastStage.interpolate (halfway, output.getSubBlock (0, 4 * numSamples));
+        }
+    }
+
+private:
+    HalfBandStage<T, 8> firstStage { HalfBandCoefficients::steep };
+    HalfBandStage<T, 6> lastStage { HalfBandCoefficients::wide };
+};
@@ -0,0 +1,179 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../Utility/Helpers.h"
+
+/** Thins out dense streams of continuous controllers (pitch wheel and CCs 0-63, bar bank select and data
+*   entry) before they reach the juce::Synthesiser, which splits its render block at every midi event. For each
+*   channel and controller, only the last value received within a window of windowSize samples is kept, and it
+*   is emitted on the next window boundary. The windows line up with the synth's processing quanta, across
+*   blocks of any size. Everything else (notes, pedals, channel mode messages...) is passed through untouched at
+*   its original sample position, and any pending controller value is emitted right before it so the order
+*   between controllers and notes is preserved. Values received at the end of a block are carried over to the
+*   start of the next one.
+*
+*   The voices then smooth these values (oscillator frequency ramps and ladder filter cutoff smoothing), so a
+*   controller stream turns into per-sample ramps instead of dozens of tiny sub-blocks.
+*/
+class MidiControllerCoalescer
+{
+public:
+    void prepare (int newWindowSize)
+    {
+        jassert (newWindowSize > 0);
+        windowSize = newWindowSize;
+
+        //make sure adding events on the audio thread doesn't need to allocate
+        coalesced.ensureSize (4096);
+    }
+
+    /** Coalesces the controllers in midiMessages, which is replaced with the result. windowPosition is how far into
+    *   its current window the block starts, see ProPhatSynthesiser::getQuantumPosition().
+    */
+    void process (juce::MidiBuffer& midiMessages, int numSamples, int windowPosition)
+    {
+        jassert (windowPosition >= 0 && windowPosition < windowSize);
+
+        if (midiMessages.isEmpty () && numPending == 0)
+            return;
+
+        coalesced.clear ();
+
+        //what was left from the last block belongs on the boundary that ends its window, which is right here if the
+        //block starts on one
+        if (windowPosition == 0)
+            flushPending (0);
+
+        auto windowEnd { windowSize - windowPosition };
+
+        for (const auto metadata : midiMessages)
+        {
+            const auto position { metadata.samplePosition };
+
+            //we crossed into a new window, so what we had pending belongs on the boundary of the previous one
+            if (position >= windowEnd)
+            {
+                const auto boundary { windowEnd + ((position - windowEnd) / windowSize) * windowSize };
+                flushPending (boundary);
+                windowEnd = boundary + windowSize;
+            }
+
+            const auto message { metadata.getMessage () };
+            if (! addPending (message, position))
+            {
+                flushPending (position);
+                coalesced.addEvent (message, position);
+            }
+        }
+
+        if (windowEnd < numSamples)
+            flushPending (windowEnd);
+
+        //copied rather than swapped, so coalesced keeps the storage reserved in prepare()
+        midiMessages.clear ();
+        midiMessages.addEvents (coalesced, 0, -1, 0);
+    }
+
+    int getNumPendingControllers () const { return numPending; }
+
+private:
+    static constexpr auto pitchWheelNumber { -1 };
+    static constexpr auto maxPendingControllers { 32 };
+
+    struct PendingController
+    {
+        int channel = 0;
+        int number = 0;     //controller number, or pitchWheelNumber
+        int value = 0;
+    };
+
+    /** Bank select and data entry come in MSB/LSB pairs, and receivers need every pair, in order. The same goes for
+    *   the RPN and NRPN numbers, which are over 63 anyway, like the switches.
+    */
+    static bool isContinuousController (int number)
+    {
+        switch (number)
+        {
+            case 0: case 32:    //bank select
+            case 6: case 38:    //data entry
+                return false;
+            default:
+                return number < 64;
+        }
+    }
+
+    /** Returns false if the message isn't a continuous controller, and should be passed through as is. */
+    bool addPending (const juce::MidiMessage& message, int position)
+    {
+        PendingController newController { message.getChannel (), pitchWheelNumber, 0 };
+
+        if (message.isPitchWheel ())
+            newController.value = message.getPitchWheelValue ();
+        else if (message.isController () && isContinuousController (message.getControllerNumber ()))
+        {
+            newController.number = message.getControllerNumber ();
+            newController.value = message.getControllerValue ();
+        }
+        else
+            return false;
+
+        for (int i = 0; i < numPending; ++i)
+        {
+            if (pending[(size_t) i].channel == newController.channel && pending[(size_t) i].number == newController.number)
+            {
+                pending[(size_t) i].value = newController.value;
+                return true;
+            }
+        }
+
+        //too many different controllers at once, emit what we have now instead of growing
+        if (numPending == maxPendingControllers)
+            flushPending (position);
+
+        pending[(size_t) numPending++] = newController;
+        return true;
+    }
+
+    void flushPending (int position)
+    {
+        for (int i = 0; i < numPending; ++i)
+        {
+            const auto& controller { pending[(size_t) i] };
+
+            if (controller.number == pitchWheelNumber)
+                coalesced.addEvent (juce::MidiMessage::pitchWheel (controller.channel, controller.value), position);
+            else
+                coalesced.addEvent (juce::MidiMessage::controllerEvent (controller.channel, controller.number, controller.value), position);
+        }
+
+        numPending = 0;
+    }
+
+    int windowSize = Constants::processingQuantum;
+
+    std::array<PendingController, maxPendingControllers> pending;
+    int numPending = 0;
+
+    juce::MidiBuffer coalesced;
+};
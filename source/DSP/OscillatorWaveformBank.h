@@ -0,0 +1,156 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../Utility/Helpers.h"
+
+/**
+ * @brief A band-limited wavetable with one level per octave. Level 0 holds every harmonic a table of tableSize
+    samples can represent, and each level above it holds half as many, down to a single sine. The oscillator picks the
+    richest level whose harmonics all stay below Nyquist for the note it's playing.
+*/
+template <std::floating_point T>
+class MipmappedWavetable
+{
+public:
+    static constexpr size_t tableSize { 2048 };
+    static constexpr size_t numLevels { 11 };
+
+    /** Sums the harmonics into every level. getHarmonic (n) returns the sine and cosine amplitudes of harmonic n,
+    *   for a cycle that starts at phase 0.
+    */
+    template <typename HarmonicFunction>
+    explicit MipmappedWavetable (HarmonicFunction&& getHarmonic);
+
+    static constexpr size_t getMaxHarmonic (size_t level) noexcept { return (tableSize / 2) >> level; }
+
+    /** Returns the richest level that doesn't alias at this phase increment, in cycles per sample. */
+    const T* getLevel (T phaseIncrement) const noexcept
+    {
+        size_t level { 0 };
+        while (level < numLevels - 1 && static_cast<T> (getMaxHarmonic (level)) * phaseIncrement > T (.5))
+            ++level;
+
+        return levels.data () + level * rowSize;
+    }
+
+    /** Reads a level with linear interpolation, for a phase in cycles. */
+    static T getSample (const T* level, T phase) noexcept
+    {
+        const auto position { phase * static_cast<T> (tableSize) };
+        const auto index { static_cast<size_t> (position) };
+        const auto fraction { position - static_cast<T> (index) };
+
+        jassert (index <= tableSize);
+        return level[index] + fraction * (level[index + 1] - level[index]);
+    }
+
+private:
+    //2 guard samples, so the interpolation never wraps, even when a phase just under 1 rounds up to 1 in T
+    static constexpr size_t rowSize { tableSize + 2 };
+
+    std::vector<T> levels;
+};
+
+template <std::floating_point T>
+template <typename HarmonicFunction>
+MipmappedWavetable<T>::MipmappedWavetable (HarmonicFunction&& getHarmonic)
+    : levels (numLevels * rowSize)
+{
+    //every harmonic is read from a single sine table, so building all levels only costs one pass per harmonic
+    std::vector<double> sine (tableSize), sum (tableSize, 0.);
+    for (size_t i = 0; i < tableSize; ++i)
+        sine[i] = std::sin (juce::MathConstants<double>::twoPi * (double) i / (double) tableSize);
+
+    //start from the sine at the top level, and add the missing harmonics on the way down
+    size_t numHarmonicsInSum { 0 };
+
+    for (auto level { numLevels }; level-- > 0;)
+    {
+        for (auto n { numHarmonicsInSum + 1 }; n <= getMaxHarmonic (level); ++n)
+        {
+            const auto [sineAmplitude, cosineAmplitude] { getHarmonic (n) };
+
+            for (size_t i = 0; i < tableSize; ++i)
+            {
+                const auto index { n * i };
+                sum[i] += sineAmplitude * sine[index % tableSize] + cosineAmplitude * sine[(index + tableSize / 4) % tableSize];
+            }
+        }
+        numHarmonicsInSum = getMaxHarmonic (level);
+
+        auto* row { levels.data () + level * rowSize };
+        for (size_t i = 0; i < tableSize; ++i)
+            row[i] = static_cast<T> (sum[i]);
+
+        row[tableSize] = row[0];
+        row[tableSize + 1] = row[1];
+    }
+}
+
+//====================================================================================================
+
+/**
+ * @brief The band-limited wavetables for all our periodic shapes, shared by every oscillator of every plugin instance
+    through a juce::SharedResourcePointer. Each sample type gets its own bank, built when the first oscillator of that
+    type is prepared, so the engine that isn't in use never builds one. The tables never change after construction,
+    so changing shapes on the audio thread only swaps the pointer an oscillator reads from.
+*/
+template <std::floating_point T>
+struct OscillatorWaveformBank
+{
+    OscillatorWaveformBank () = default;
+
+    /** Returns the wavetable for a shape, or nullptr for shapes that aren't periodic (none and noise). */
+    const MipmappedWavetable<T>* getWavetable (OscShape::Values shape) const noexcept
+    {
+        switch (shape)
+        {
+            case OscShape::saw:         return &saw;
+            case OscShape::sawTri:      return &sawTri;
+            case OscShape::triangle:    return &triangle;
+            case OscShape::pulse:       return &pulse;
+            default:                    return nullptr;
+        }
+    }
+
+    const MipmappedWavetable<T> saw { getSawHarmonic },
+                                sawTri { getSawTriHarmonic },
+                                triangle { getTriangleHarmonic },
+                                pulse { getPulseHarmonic };
+
+private:
+    using Harmonic = std::pair<double, double>;
+
+    static constexpr auto pi { juce::MathConstants<double>::pi };
+
+    //these match the shapes in PolyBlep.h: the saw rises from -1, the pulse is -1 for its first half, and the triangle starts at -1
+    static Harmonic getSawHarmonic (size_t n)       { return { -2. / (pi * (double) n), 0. }; }
+    static Harmonic getPulseHarmonic (size_t n)     { return n % 2 == 0 ? Harmonic {} : Harmonic { -4. / (pi * (double) n), 0. }; }
+    static Harmonic getTriangleHarmonic (size_t n)  { return n % 2 == 0 ? Harmonic {} : Harmonic { 0., -8. / (pi * pi * (double) (n * n)) }; }
+
+    static Harmonic getSawTriHarmonic (size_t n)
+    {
+        const auto sawHarmonic { getSawHarmonic (n) }, triangleHarmonic { getTriangleHarmonic (n) };
+        return { (sawHarmonic.first + triangleHarmonic.first) / 2, (sawHarmonic.second + triangleHarmonic.second) / 2 };
+    }
+};
@@ -22,6 +22,8 @@
 
 #pragma once
 #include "GainedOscillator.h"
+#include "../Utility/AlignedArena.h"
+#include "../Utility/TuningTable.h"
 
 /**
  * @brief A container for all our oscillators.
@@ -30,26 +32,41 @@ template <std::floating_point T>
 class PhatOscillators : public juce::AudioProcessorValueTreeState::Listener
 {
 public:
-    PhatOscillators (juce::AudioProcessorValueTreeState& processorState);
+    PhatOscillators (juce::AudioProcessorValueTreeState& processorState, const TuningTable& tuningTable);
 
     void addParamListenersToState ();
     void parameterChanged (const juce::String& parameterID, float newValue) override;
 
-    void prepare (const juce::dsp::ProcessSpec& spec);
+    /** Prepares the oscillators, taking their scratch blocks out of the voice's arena. */
+    void prepare (const juce::dsp::ProcessSpec& spec, AlignedArena& arena);
 
-    juce::dsp::AudioBlock<T>& prepareRender (int numSamples);
-    juce::dsp::AudioBlock<T> process (int pos, int curBlockSize);
+    /** The number of arena bytes prepare() will use for this spec. */
+    static size_t getArenaSize (const juce::dsp::ProcessSpec& spec);
+
+    /** Renders the oscillators at a multiple of the sample rate they were prepared with, for oversampling. This keeps
+    *   their phases, and the blocks they render into must have been prepared big enough for it.
+    */
+    void setSampleRate (double newSampleRate);
+
+    /** Renders the next numSamples of all the oscillators into our mix block, and returns that. */
+    juce::dsp::AudioBlock<T> process (int numSamples);
 
     void setLfoOsc1NoteOffset (float theLfoOsc1NoteOffset)
     {
+        if (theLfoOsc1NoteOffset == lfoOsc1NoteOffset)
+            return;
+
         lfoOsc1NoteOffset = theLfoOsc1NoteOffset;
-        updateOscFrequenciesInternal ();
+        baseFrequenciesDirty.store (true);
     }
 
     void setLfoOsc2NoteOffset (float theLfoOsc2NoteOffset)
     {
+        if (theLfoOsc2NoteOffset == lfoOsc2NoteOffset)
+            return;
+
         lfoOsc2NoteOffset = theLfoOsc2NoteOffset;
-        updateOscFrequenciesInternal ();
+        baseFrequenciesDirty.store (true);
     }
 
     enum class OscId
@@ -58,15 +75,54 @@ public:
         osc2Index,
     };
 
-    void updateOscFrequencies (int midiNote, float velocity, int currentPitchWheelPosition)
+    /** Starts a new note. This is the only place the slop offsets are drawn, so they stay the same for the whole note. */
+    void updateOscFrequencies (int midiNote, float velocity, float newPitchWheelRatio)
     {
-        pitchWheelPosition = currentPitchWheelPosition;
+        pitchWheelRatio = newPitchWheelRatio;
         curVelocity = velocity;
         curMidiNote = midiNote;
+        glideNote = (float) midiNote;
+
+        slopOsc1 = static_cast<T> (slopRandom.nextFloat () * 2.f - 1.f);
+        slopOsc2 = static_cast<T> (slopRandom.nextFloat () * 2.f - 1.f);
 
         updateOscFrequenciesInternal ();
     }
 
+    /** Everything the frequencies depend on only marks them as dirty, and they are recomputed here, at most once per
+    *   control tick, however many of those changed. Called on the audio thread at the end of each quantum.
+    */
+    void updateFrequencies ();
+
+    /** The highest frequency osc1 or osc2 is playing, which is what decides how much a voice needs oversampling. */
+    T getHighestFrequency () const { return juce::jmax (osc1BaseFreq, osc2BaseFreq) * pitchWheelRatio; }
+
+    /** True when updateFrequencies() has something to do, in which case the voice can't skip its control ticks. */
+    bool needsFrequencyUpdate () const { return baseFrequenciesDirty.load () || pitchWheelChanged; }
+
+    /** Sets how long glideTo() takes to reach a new note. */
+    void setGlideTime (float seconds)
+    {
+        jassert (Helpers::valueContainedInRange (seconds, Constants::glideRange));
+        glideSeconds = seconds;
+    }
+
+    /** Moves the oscillators of a playing note to midiNote, gliding there over the glide time. */
+    void glideTo (int midiNote);
+
+    bool isGliding () const { return glideNote != (float) curMidiNote; }
+
+    /** Moves the gliding note one control tick closer to its target. Called on the audio thread, once per quantum,
+    *   before updateFrequencies().
+    */
+    void updateGlide ();
+
+    void setVelocity (float velocity)
+    {
+        curVelocity = velocity;
+        updateOscLevels ();
+    }
+
     void setOscFreq (OscId oscNum, int newMidiNote);
     void setOscShape (OscId oscNum, OscShape::Values newShape);
     void setOscTuning (OscId oscNum, float newTuning);
@@ -89,9 +145,11 @@ public:
     {
         jassert (Helpers::valueContainedInRange (slop, Constants::slopSliderRange));
         slopMod = slop;
-        updateOscFrequenciesInternal ();
+        baseFrequenciesDirty.store (true);
     }
 
+    void setUnisonParam (juce::StringRef parameterID, float newValue);
+
     void setOscMix (float newMix)
     {
         jassert (Helpers::valueContainedInRange (newMix, Constants::sliderRange));
@@ -103,9 +161,11 @@ public:
     void updateOscLevels ()
     {
         sub.setGain (curVelocity * curSubLevel);
-        noise.setGain (curVelocity * curNoiseLevel);
+        noise.setGain (curVelocity * curNoiseLevel * noiseScale);
         osc1.setGain (curVelocity * (1 - oscMix));
         osc2.setGain (curVelocity * oscMix);
+
+        updateActiveStages ();
     }
 
     void resetLfoOscNoteOffsets ()
@@ -114,26 +174,71 @@ public:
         lfoOsc2NoteOffset = 0.f;
     }
 
-    void pitchWheelMoved (int newPitchWheelValue)
+    /** Sets a new pitch wheel frequency ratio, precomputed in ChannelControllerState. This only scales the
+    *   cached base frequencies, and the oscillators ramp to the new values instead of jumping.
+    */
+    void setPitchWheelRatio (float newPitchWheelRatio)
     {
-        pitchWheelPosition = newPitchWheelValue;
-        updateOscFrequenciesInternal ();
+        if (newPitchWheelRatio == pitchWheelRatio)
+            return;
+
+        pitchWheelRatio = newPitchWheelRatio;
+        pitchWheelChanged = true;
     }
 
+    /** Called on the audio thread when the TuningTable changed, to move a playing note to its new pitch. */
+    void retune () { baseFrequenciesDirty.store (true); }
+
 private:
+    enum StageFlags
+    {
+        subStage   = 1 << 0,
+        osc1Stage  = 1 << 1,
+        osc2Stage  = 1 << 2,
+        noiseStage = 1 << 3,
+        numStageCombinations = 1 << 4
+    };
+
+    /** Picks the render kernel matching the oscillators that can currently be heard. Called whenever the
+    *   levels or shapes change, so process() never computes or sums a silent stage.
+    */
+    void updateActiveStages ();
+
+    /** Renders all the active stages in a single pass over the mix block: the phases of osc1, osc2 and the sub are
+    *   advanced together a chunk at a time, their shapes are summed with their levels in a buffer on the stack, and
+    *   that is written once to each channel. The unison stacks and the noise then add to it, with their own levels.
+    */
+    template <bool withSub, bool withOsc1, bool withOsc2, bool withNoise>
+    juce::dsp::AudioBlock<T> processStages (int subBlockSize);
+
+    using RenderKernel = juce::dsp::AudioBlock<T> (PhatOscillators::*) (int);
+
+    template <size_t... stages>
+    static constexpr std::array<RenderKernel, numStageCombinations> makeRenderKernels (std::index_sequence<stages...>)
+    {
+        return { &PhatOscillators::processStages<(stages & subStage) != 0, (stages & osc1Stage) != 0,
+                                                 (stages & osc2Stage) != 0, (stages & noiseStage) != 0>... };
+    }
+
+    std::atomic<int> activeStages { 0 };
+
     void updateOscFrequenciesInternal ();
+    void updateBaseFrequencies ();
+    void applyOscFrequencies (bool force);
 
     juce::AudioProcessorValueTreeState& state;
+    const TuningTable& tuning;
+
+    static juce::dsp::AudioBlock<T> allocateBlock (const juce::dsp::ProcessSpec& spec, AlignedArena& arena);
 
-    juce::HeapBlock<char> heapBlock1, heapBlock2, heapBlockNoise;
+    juce::dsp::AudioBlock<T> mixBlock;
 
-    juce::dsp::AudioBlock<T> osc1Block, osc2Block, noiseBlock, osc1Output, osc2Output, noiseOutput;
+    //the sub doesn't have a phase of its own, it follows osc1's, see ProPhatOscillator::getNextPhases()
     GainedOscillator<T> sub, osc1, osc2, noise;
 
     float osc1NoteOffset, osc2NoteOffset;
 
-    std::uniform_real_distribution<T> distribution;
-    std::default_random_engine generator;
+    juce::Random slopRandom;
 
     float osc1TuningOffset = 0.f;
     float osc2TuningOffset = 0.f;
@@ -143,24 +248,43 @@ private:
     float oscMix = 0.f;
     float curNoiseLevel = 0.f;
 
+    int unisonVoices = Constants::defaultUnisonVoices;
+    float unisonDetune = Constants::defaultUnisonDetune;
+    float unisonSpread = Constants::defaultUnisonSpread;
+
     T slopOsc1{ 0 }, slopOsc2{ 0 }, slopMod{ 0 };
 
-    int pitchWheelPosition = 0;
+    //frequencies without the pitch wheel, so pitch wheel changes are only a multiplication
+    T osc1BaseFreq { 0 }, osc2BaseFreq { 0 };
+    float pitchWheelRatio = 1.f;
+
+    //set by anything that moves the base frequencies, from any thread, and by the pitch wheel, on the audio thread
+    std::atomic<bool> baseFrequenciesDirty { false };
+    bool pitchWheelChanged = false;
 
     float lfoOsc1NoteOffset = 0.f;
     float lfoOsc2NoteOffset = 0.f;
 
-    int curMidiNote;
+    int curMidiNote = -1;
+
+    //the note the oscillators are actually playing, which moves towards curMidiNote when gliding
+    float glideNote = 0.f, glideStep = 0.f;
+    float glideSeconds = Constants::defaultGlideTime;
+    double controlRate = 0.;
+
+    //white noise spreads the same power over the whole band, so it's boosted to sound the same when oversampled
+    double preparedSampleRate = 0.;
+    float noiseScale = 1.f;
 };
 
 //====================================================================================================
 
 template <std::floating_point T>
-PhatOscillators<T>::PhatOscillators (juce::AudioProcessorValueTreeState& processorState)
+PhatOscillators<T>::PhatOscillators (juce::AudioProcessorValueTreeState& processorState, const TuningTable& tuningTable)
     : state (processorState)
+    , tuning (tuningTable)
     , osc1NoteOffset { static_cast<float> (Constants::middleCMidiNote - Constants::defaultOscMidiNote) }
     , osc2NoteOffset { osc1NoteOffset }
-    , distribution (-1.f, 1.f)
 {
     addParamListenersToState ();
 
@@ -187,6 +311,12 @@ void PhatOscillators<T>::addParamListenersToState ()
     state.addParameterListener (oscMixID.getParamID (), this);
     state.addParameterListener (oscNoiseID.getParamID (), this);
     state.addParameterListener (oscSlopID.getParamID (), this);
+
+    state.addParameterListener (glideID.getParamID (), this);
+
+    state.addParameterListener (unisonVoicesID.getParamID (), this);
+    state.addParameterListener (unisonDetuneID.getParamID (), this);
+    state.addParameterListener (unisonSpreadID.getParamID (), this);
 }
 
 template <std::floating_point T>
@@ -214,16 +344,41 @@ void PhatOscillators<T>::parameterChanged (const juce::String& parameterID, floa
         setOscNoise (newValue);
     else if (parameterID == oscSlopID.getParamID ())
         setOscSlop (newValue);
+    else if (parameterID == glideID.getParamID ())
+        setGlideTime (newValue);
+    else if (parameterID == unisonVoicesID.getParamID ()
+             || parameterID == unisonDetuneID.getParamID ()
+             || parameterID == unisonSpreadID.getParamID ())
+        setUnisonParam (parameterID, newValue);
     else
         jassertfalse;
 }
 
 template <std::floating_point T>
-void PhatOscillators<T>::prepare (const juce::dsp::ProcessSpec& spec)
+juce::dsp::AudioBlock<T> PhatOscillators<T>::allocateBlock (const juce::dsp::ProcessSpec& spec, AlignedArena& arena)
 {
-    osc1Block = juce::dsp::AudioBlock<T> (heapBlock1, spec.numChannels, spec.maximumBlockSize);
-    osc2Block = juce::dsp::AudioBlock<T> (heapBlock2, spec.numChannels, spec.maximumBlockSize);
-    noiseBlock = juce::dsp::AudioBlock<T> (heapBlockNoise, spec.numChannels, spec.maximumBlockSize);
+    auto channels { arena.allocate<T*> (spec.numChannels) };
+    for (size_t c = 0; c < spec.numChannels; ++c)
+        channels[c] = arena.allocate<T> (spec.maximumBlockSize);
+
+    return { channels, spec.numChannels, spec.maximumBlockSize };
+}
+
+template <std::floating_point T>
+size_t PhatOscillators<T>::getArenaSize (const juce::dsp::ProcessSpec& spec)
+{
+    return AlignedArena::getAllocationSize<T*> (spec.numChannels)
+         + spec.numChannels * AlignedArena::getAllocationSize<T> (spec.maximumBlockSize);
+}
+
+template <std::floating_point T>
+void PhatOscillators<T>::prepare (const juce::dsp::ProcessSpec& spec, AlignedArena& arena)
+{
+    //all the stages are mixed straight into this
+    mixBlock = allocateBlock (spec, arena);
+
+    controlRate = spec.sampleRate / Constants::processingQuantum;
+    preparedSampleRate = spec.sampleRate;
 
     sub.prepare (spec);
     noise.prepare (spec);
@@ -232,68 +387,220 @@ void PhatOscillators<T>::prepare (const juce::dsp::ProcessSpec& spec)
 }
 
 template <std::floating_point T>
-juce::dsp::AudioBlock<T>& PhatOscillators<T>::prepareRender (int numSamples)
+void PhatOscillators<T>::setSampleRate (double newSampleRate)
+{
+    //the glide still ticks at the control rate, which doesn't change
+    sub.setSampleRate (newSampleRate);
+    noise.setSampleRate (newSampleRate);
+    osc1.setSampleRate (newSampleRate);
+    osc2.setSampleRate (newSampleRate);
+
+    noiseScale = static_cast<float> (std::sqrt (newSampleRate / preparedSampleRate));
+    updateOscLevels ();
+}
+
+template <std::floating_point T>
+juce::dsp::AudioBlock<T> PhatOscillators<T>::process (int numSamples)
+{
+    static constexpr auto renderKernels { makeRenderKernels (std::make_index_sequence<numStageCombinations> ()) };
+
+    return (this->*renderKernels[(size_t) activeStages.load ()]) (numSamples);
+}
+
+template <std::floating_point T>
+void PhatOscillators<T>::updateActiveStages ()
 {
-    osc1Output = osc1Block.getSubBlock (0, (size_t) numSamples);
-    osc1Output.clear ();
+    auto stages { 0 };
 
-    osc2Output = osc2Block.getSubBlock (0, (size_t) numSamples);
-    osc2Output.clear ();
+    //the sub is rendered in the same block as osc1, so it is scaled by osc1's gain as well
+    if (osc1.isAudible ())
+    {
+        stages |= osc1Stage;
+
+        if (sub.isAudible ())
+            stages |= subStage;
+    }
+
+    if (osc2.isAudible ())
+        stages |= osc2Stage;
 
-    noiseOutput = noiseBlock.getSubBlock (0, (size_t) numSamples);
-    noiseOutput.clear ();
+    if (noise.isAudible ())
+        stages |= noiseStage;
 
-    return noiseBlock;
+    activeStages.store (stages);
 }
 
 template <std::floating_point T>
-juce::dsp::AudioBlock<T> PhatOscillators<T>::process (int pos, int subBlockSize)
+template <bool withSub, bool withOsc1, bool withOsc2, bool withNoise>
+juce::dsp::AudioBlock<T> PhatOscillators<T>::processStages (int subBlockSize)
 {
-    //process osc1
-    auto block1 { osc1Output.getSubBlock (pos, subBlockSize) };
-    juce::dsp::ProcessContextReplacing<T> osc1Context (block1);
-    sub.process (osc1Context); //TODO: is the sub on osc1 because that's how it is on the real prophet? Should it be added to the noise below instead?
-    osc1.process (osc1Context);
-
-    //process osc2
-    auto block2 { osc2Output.getSubBlock (pos, subBlockSize) };
-    juce::dsp::ProcessContextReplacing<T> osc2Context (block2);
-    osc2.process (osc2Context);
-
-    //process noise
-    auto blockAll { noiseOutput.getSubBlock (pos, subBlockSize) };
-    juce::dsp::ProcessContextReplacing<T> noiseContext (blockAll);
-    noise.process (noiseContext);
-
-    //process the sum of osc1 and osc2
-    blockAll.add (block1);
-    blockAll.add (block2);
+    static constexpr size_t chunkSize { (size_t) Constants::processingQuantum };
+
+    auto blockAll { mixBlock.getSubBlock (0, (size_t) subBlockSize) };
+    const auto numSamples { blockAll.getNumSamples () };
+
+    auto& osc1Oscillator { osc1.getUpdatedOscillator () };
+    auto& osc2Oscillator { osc2.getUpdatedOscillator () };
+    auto& subOscillator { sub.getUpdatedOscillator () };
+
+    //the stacks are rendered on their own, but the sub still needs osc1's phases
+    const auto osc1Stacked { withOsc1 && osc1.isStacked () };
+    const auto osc2Stacked { withOsc2 && osc2.isStacked () };
+    const auto needsOsc1Phases { withSub || (withOsc1 && ! osc1Stacked) };
+
+    //the stacks follow their oscillator's frequency ramp, from where it is at now
+    const auto osc1StartFrequency { osc1Oscillator.getCurrentFrequency () };
+    const auto osc2StartFrequency { osc2Oscillator.getCurrentFrequency () };
+
+    //the sub is on osc1, so osc1's level applies to it as well. TODO: is that how it is on the real prophet? Should it be on the noise instead?
+    const auto osc1Gain { osc1.getGain () };
+    const auto subGain { sub.getGain () * osc1Gain };
+    const auto osc2Gain { osc2.getGain () };
+
+    alignas (64) std::array<T, chunkSize> osc1Phases, osc1Increments, osc2Phases, osc2Increments, subPhases, subIncrements, mix;
+
+    for (size_t start = 0; start < numSamples; start += chunkSize)
+    {
+        const auto num { juce::jmin (chunkSize, numSamples - start) };
+        std::fill (mix.begin (), mix.begin () + (std::ptrdiff_t) num, T (0));
+
+        if (needsOsc1Phases)
+        {
+            const auto maxIncrement { osc1Oscillator.getNextPhases (osc1Phases.data (), osc1Increments.data (), num,
+                                                                    withSub ? subPhases.data () : nullptr) };
+
+            if (withOsc1 && ! osc1Stacked)
+                osc1Oscillator.addShape (mix.data (), osc1Phases.data (), osc1Increments.data (), maxIncrement, num, osc1Gain);
+
+            if constexpr (withSub)
+            {
+                for (size_t i = 0; i < num; ++i)
+                    subIncrements[i] = osc1Increments[i] * T (.5);
+
+                subOscillator.addShape (mix.data (), subPhases.data (), subIncrements.data (), maxIncrement * T (.5), num, subGain);
+            }
+        }
+
+        if (withOsc2 && ! osc2Stacked)
+        {
+            const auto maxIncrement { osc2Oscillator.getNextPhases (osc2Phases.data (), osc2Increments.data (), num) };
+            osc2Oscillator.addShape (mix.data (), osc2Phases.data (), osc2Increments.data (), maxIncrement, num, osc2Gain);
+        }
+
+        //the only write to the output, so it doesn't need clearing
+        for (size_t c = 0; c < blockAll.getNumChannels (); ++c)
+            juce::FloatVectorOperations::copy (blockAll.getChannelPointer (c) + start, mix.data (), (int) num);
+    }
+
+    if (osc1Stacked)
+    {
+        //getting the phases for the sub already moved osc1's ramp on
+        if (! withSub)
+            osc1Oscillator.skipFrequency ((int) numSamples);
+
+        osc1.addStack (blockAll, osc1Gain, osc1StartFrequency);
+    }
+
+    if (osc2Stacked)
+    {
+        osc2Oscillator.skipFrequency ((int) numSamples);
+        osc2.addStack (blockAll, osc2Gain, osc2StartFrequency);
+    }
+
+    if constexpr (withNoise)
+        noise.addNoise (blockAll, noise.getGain ());
 
     //and return that to the voice so it can render what's after the oscillators
     return blockAll;
 }
 
+//applies the frequencies right away, for new notes and glides that are too short to glide
 template <std::floating_point T>
 void PhatOscillators<T>::updateOscFrequenciesInternal ()
 {
+    baseFrequenciesDirty.store (false);
+    pitchWheelChanged = false;
+
     if (curMidiNote < 0)
         return;
 
-    auto pitchWheelDeltaNote = Constants::pitchWheelNoteRange.convertFrom0to1 (pitchWheelPosition / 16383.f);
+    updateBaseFrequencies ();
+    applyOscFrequencies (true);
+}
+
+template <std::floating_point T>
+void PhatOscillators<T>::updateFrequencies ()
+{
+    if (baseFrequenciesDirty.exchange (false))
+    {
+        pitchWheelChanged = false;
+
+        if (curMidiNote < 0)
+            return;
 
-    slopOsc1 = distribution (generator);
-    slopOsc2 = distribution (generator);
+        //the slop offsets are kept, so nothing wobbles when the lfo or the glide moves the note
+        updateBaseFrequencies ();
+        applyOscFrequencies (true);
+    }
+    else if (std::exchange (pitchWheelChanged, false) && curMidiNote >= 0)
+    {
+        applyOscFrequencies (false);
+    }
+}
 
+template <std::floating_point T>
+void PhatOscillators<T>::updateBaseFrequencies ()
+{
     const auto curOsc1Slop = slopOsc1 * slopMod;
     const auto curOsc2Slop = slopOsc2 * slopMod;
 
-    const auto osc1FloatNote = curMidiNote - osc1NoteOffset + osc1TuningOffset + lfoOsc1NoteOffset + pitchWheelDeltaNote + curOsc1Slop;
-    sub.setFrequency (Helpers::getMidiNoteInHertz(osc1FloatNote - 12), true);
-    noise.setFrequency (Helpers::getMidiNoteInHertz (osc1FloatNote), true);
-    osc1.setFrequency (Helpers::getMidiNoteInHertz (osc1FloatNote), true);
+    //only the key is tuned by the table. The transpositions and modulations are in semitones on top of it, so they
+    //keep their size in scales that don't have 12 notes per octave
+    const auto keyPitch { tuning.getPitch (glideNote) };
+    osc1BaseFreq = FastMath::exp2 (keyPitch + (osc1TuningOffset - osc1NoteOffset + lfoOsc1NoteOffset + curOsc1Slop) / 12.f);
+    osc2BaseFreq = FastMath::exp2 (keyPitch + (osc2TuningOffset - osc2NoteOffset + lfoOsc2NoteOffset + curOsc2Slop) / 12.f);
+}
+
+template <std::floating_point T>
+void PhatOscillators<T>::glideTo (int midiNote)
+{
+    jassert (curMidiNote >= 0); //only a playing note can glide
+
+    curMidiNote = midiNote;
+
+    const auto numTicks { glideSeconds * controlRate };
+    if (numTicks < 1)
+    {
+        glideNote = (float) midiNote;
+        updateOscFrequenciesInternal ();
+        return;
+    }
 
-    const auto osc2Freq = Helpers::getMidiNoteInHertz (curMidiNote - osc2NoteOffset + osc2TuningOffset + lfoOsc2NoteOffset + pitchWheelDeltaNote + curOsc2Slop);
-    osc2.setFrequency (osc2Freq, true);
+    //constant glide time, whatever the interval
+    glideStep = (float) (std::abs ((float) midiNote - glideNote) / numTicks);
+}
+
+template <std::floating_point T>
+void PhatOscillators<T>::updateGlide ()
+{
+    if (! isGliding ())
+        return;
+
+    const auto target { (float) curMidiNote };
+    glideNote = glideNote < target ? juce::jmin (glideNote + glideStep, target)
+                                   : juce::jmax (glideNote - glideStep, target);
+
+    //the glide is already smooth at control rate, and updateFrequencies() skips the oscillators' own frequency ramp,
+    //which would lag behind it
+    baseFrequenciesDirty.store (true);
+}
+
+template <std::floating_point T>
+void PhatOscillators<T>::applyOscFrequencies (bool force)
+{
+    //the sub follows osc1's phase, and the noise doesn't have a frequency
+    osc1.setFrequency (osc1BaseFreq * pitchWheelRatio, force);
+    osc2.setFrequency (osc2BaseFreq * pitchWheelRatio, force);
 }
 
 template <std::floating_point T>
@@ -314,7 +621,7 @@ void PhatOscillators<T>::setOscFreq (OscId oscNum, int newMidiNote)
             break;
     }
 
-    updateOscFrequenciesInternal ();
+    baseFrequenciesDirty.store (true);
 }
 
 template <std::floating_point T>
@@ -332,6 +639,25 @@ void PhatOscillators<T>::setOscShape (OscId oscNum, OscShape::Values newShape)
             jassertfalse;
             break;
     }
+
+    updateActiveStages ();
+}
+
+template <std::floating_point T>
+void PhatOscillators<T>::setUnisonParam (juce::StringRef parameterID, float newValue)
+{
+    if (parameterID == ProPhatParameterIds::unisonVoicesID.getParamID ())
+        unisonVoices = (int) newValue;
+    else if (parameterID == ProPhatParameterIds::unisonDetuneID.getParamID ())
+        unisonDetune = newValue;
+    else if (parameterID == ProPhatParameterIds::unisonSpreadID.getParamID ())
+        unisonSpread = newValue;
+    else
+        jassertfalse;
+
+    //only the main oscillators are stacked, not the sub or the noise
+    osc1.setUnison (unisonVoices, unisonDetune, unisonSpread);
+    osc2.setUnison (unisonVoices, unisonDetune, unisonSpread);
 }
 
 template <std::floating_point T>
@@ -351,5 +677,5 @@ void PhatOscillators<T>::setOscTuning (OscId oscNum, float newTuning)
             jassertfalse;
             break;
     }
-    updateOscFrequenciesInternal ();
+    baseFrequenciesDirty.store (true);
 }
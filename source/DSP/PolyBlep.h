@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../Utility/Helpers.h"
+
+/** Band-limited versions of our oscillator shapes, using 2-sample polynomial residuals: PolyBLEP for the jumps of the
+*   saw and pulse, and PolyBLAMP for the corners of the triangle. There are no branches or comparisons, so loops over a
+*   block of phases vectorise.
+*
+*   The phase is in cycles, in [0, 1), and phaseIncrement is the phase advance per sample, so 1 sample is phaseIncrement
+*   cycles wide. The shapes match the naive ones in OscillatorWaveformBank.
+*/
+namespace PolyBlep
+{
+/** max (x, 0) without a comparison, which compilers won't if-convert in a loop when floating point may trap. */
+template <std::floating_point T>
+inline T positivePart (T x)
+{
+    return (x + std::abs (x)) / 2;
+}
+
+/** The residual of a unit step up at phase 0, ie the difference between a band-limited step and a naive one. */
+template <std::floating_point T>
+inline T blep (T phase, T phaseIncrement)
+{
+    //how far into the sample after the step, and into the one before it, we are. Both are 0 outside those samples
+    const auto after { positivePart (1 - phase / phaseIncrement) };
+    const auto before { positivePart (1 - (1 - phase) / phaseIncrement) };
+
+    return (before * before - after * after) / 2;
+}
+
+/** The residual of a unit change of slope at phase 0, with the slope in units per sample. This is the integral of blep(). */
+template <std::floating_point T>
+inline T blamp (T phase, T phaseIncrement)
+{
+    const auto after { positivePart (1 - phase / phaseIncrement) };
+    const auto before { positivePart (1 - (1 - phase) / phaseIncrement) };
+
+    return (before * before * before + after * after * after) / 6;
+}
+
+/** The phase half a cycle later, where the pulse and triangle have their second discontinuity. */
+template <std::floating_point T>
+inline T getHalfCycleLater (T phase)
+{
+    const auto later { phase + T (.5) };
+    return later - static_cast<T> (static_cast<int> (later));
+}
+
+template <std::floating_point T>
+inline T saw (T phase, T phaseIncrement)
+{
+    //drops by 2 at phase 0
+    return 2 * phase - 1 - 2 * blep (phase, phaseIncrement);
+}
+
+template <std::floating_point T>
+inline T pulse (T phase, T phaseIncrement)
+{
+    //a saw minus the same saw half a cycle later is -1 then 1, and both of its jumps are band-limited
+    return saw (phase, phaseIncrement) - saw (getHalfCycleLater (phase), phaseIncrement);
+}
+
+template <std::floating_point T>
+inline T triangle (T phase, T phaseIncrement)
+{
+    //the slope goes from -4 to +4 per cycle at phase 0 and back half a cycle later, so it changes by 8 * phaseIncrement per sample
+    const auto naive { 1 - 4 * std::abs (phase - T (.5)) };
+    const auto slopeChange { 8 * phaseIncrement };
+
+    return naive + slopeChange * (blamp (phase, phaseIncrement) - blamp (getHalfCycleLater (phase), phaseIncrement));
+}
+
+/** Any of the periodic shapes. The residuals are capped to a quarter cycle on each side, so the 2 discontinuities
+*   of the pulse and triangle never overlap, even above a quarter of the sample rate.
+*/
+template <OscShape::Values shape, std::floating_point T>
+inline T getSample (T phase, T phaseIncrement)
+{
+    phaseIncrement = juce::jmin (phaseIncrement, T (.25));
+
+    if constexpr (shape == OscShape::saw)
+        return saw (phase, phaseIncrement);
+    else if constexpr (shape == OscShape::sawTri)
+        return (saw (phase, phaseIncrement) + triangle (phase, phaseIncrement)) / 2;
+    else if constexpr (shape == OscShape::triangle)
+        return triangle (phase, phaseIncrement);
+    else if constexpr (shape == OscShape::pulse)
+        return pulse (phase, phaseIncrement);
+    else
+        return T (0);
+}
+}
@@ -0,0 +1,306 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "OscillatorWaveformBank.h"
+#include "PolyBlep.h"
+
+/**
+ * @brief A replacement for juce::dsp::Oscillator, which keeps its phase in double precision whatever T is.
+    In the float engine, juce::dsp::Oscillator accumulates its phase in float, so long notes slowly drift out of tune.
+    Here only the phase accumulator is a double, the generator and all the sample math stay in T.
+    Instead of a generator, the oscillator can also render one of our periodic shapes band-limited, either with
+    PolyBLEP (see setBandLimitedShape()) or from a shared mipmapped wavetable (see setWavetable()).
+*/
+template <std::floating_point T>
+class ProPhatOscillator
+{
+public:
+    ProPhatOscillator () = default;
+
+    bool isInitialised () const noexcept
+    {
+        return wavetable.load (std::memory_order_relaxed) != nullptr || bandLimitedShape != OscShape::none || static_cast<bool> (generator);
+    }
+
+    /** Same as juce::dsp::Oscillator::initialise(). Building a lookup table allocates, so don't ask for one on the audio thread. */
+    void initialise (const std::function<T (T)>& function, size_t lookupTableNumPoints = 0)
+    {
+        if (lookupTableNumPoints != 0)
+        {
+            auto* table { new juce::dsp::LookupTableTransform<T> (function, -juce::MathConstants<T>::pi, juce::MathConstants<T>::pi, lookupTableNumPoints) };
+            lookupTable.reset (table);
+            generator = [table] (T x) { return (*table) (x); };
+        }
+        else
+        {
+            generator = function;
+        }
+
+        bandLimitedShape = OscShape::none;
+        wavetable.store (nullptr, std::memory_order_relaxed);
+    }
+
+    /** Renders one of the periodic shapes with PolyBLEP and PolyBLAMP instead of calling a generator. These are computed
+    *   a chunk of samples at a time, which vectorises. Calling initialise() goes back to using a generator.
+    */
+    void setBandLimitedShape (OscShape::Values newShape) noexcept
+    {
+        jassert (newShape != OscShape::noise && newShape != OscShape::totalSelectable);
+        bandLimitedShape = newShape;
+        wavetable.store (nullptr, std::memory_order_relaxed);
+    }
+
+    /** Renders a wavetable instead of a generator, choosing its level from the current frequency. The wavetable isn't
+    *   owned and must outlive the oscillator. It is only read, so switching shapes is a pointer swap that is safe on the
+    *   audio thread. Calling initialise() or setBandLimitedShape() stops using it.
+    */
+    void setWavetable (const MipmappedWavetable<T>* newWavetable) noexcept
+    {
+        jassert (newWavetable != nullptr);
+        bandLimitedShape = OscShape::none;
+        wavetable.store (newWavetable, std::memory_order_relaxed);
+    }
+
+    void setFrequency (T newFrequency, bool force = false) noexcept
+    {
+        if (force)
+            frequency.setCurrentAndTargetValue (newFrequency);
+        else
+            frequency.setTargetValue (newFrequency);
+    }
+
+    T getFrequency () const noexcept { return frequency.target; }
+
+    /** Where the frequency ramp is at, ie the frequency of the last sample rendered. */
+    T getCurrentFrequency () const noexcept { return frequency.getCurrentValue (); }
+
+    /** Moves the frequency ramp on by numSamples without rendering anything, for a unison stack that is rendered
+    *   instead of this oscillator and follows its frequency, see UnisonOscillator::process().
+    */
+    void skipFrequency (int numSamples) noexcept { frequency.skip (numSamples); }
+
+    void prepare (const juce::dsp::ProcessSpec& spec) noexcept
+    {
+        sampleRate = spec.sampleRate;
+        reset ();
+    }
+
+    /** Changes the sample rate without resetting the phase, so a playing oscillator doesn't click. A glide or a bend
+    *   in progress carries on, over the same time as before.
+    */
+    void setSampleRate (double newSampleRate) noexcept
+    {
+        frequency.rescale (newSampleRate / sampleRate, getRampSteps (newSampleRate));
+        sampleRate = newSampleRate;
+    }
+
+    void reset () noexcept
+    {
+        phase = 0.;
+        oddCycle = false;
+        frequency.reset (getRampSteps (sampleRate));
+    }
+
+    T processSample (T input) noexcept
+    {
+        jassert (isInitialised () && bandLimitedShape == OscShape::none);
+        return input + generator (advance (getIncrement (frequency.getNextValue ())));
+    }
+
+    /** Accumulates the next phases in double, and hands them over with their increments in cycles. Returns the largest
+    *   increment. When subPhases isn't null, it also gets the phases of an oscillator one octave below, locked to this one.
+    */
+    T getNextPhases (T* phases, T* increments, size_t num, T* subPhases = nullptr) noexcept;
+
+    /** Adds the wavetable or band-limited shape at these phases to samples, scaled by gain. This and getNextPhases() let
+    *   a kernel render several oscillators together, see PhatOscillators::processStages().
+    */
+    void addShape (T* samples, const T* phases, const T* increments, T maxIncrement, size_t num, T gain) const noexcept;
+
+private:
+    template <OscShape::Values shape>
+    static void addBandLimited (T* samples, const T* phases, const T* increments, size_t num, T gain) noexcept;
+
+    double getIncrement (T curFrequency) const noexcept { return twoPi * (double) curFrequency / sampleRate; }
+
+    static int getRampSteps (double rate) noexcept { return (int) std::floor (rampSeconds * rate); }
+
+    /** Returns the current phase, in the [-pi, pi) range the generators expect, then moves to the next one. */
+    T advance (double increment) noexcept
+    {
+        const auto last { phase };
+
+        phase += increment;
+        while (phase >= twoPi)
+        {
+            phase -= twoPi;
+            oddCycle = ! oddCycle;
+        }
+
+        return static_cast<T> (last - juce::MathConstants<double>::pi);
+    }
+
+    static constexpr auto twoPi { juce::MathConstants<double>::twoPi };
+    static constexpr auto rampSeconds { .05 };
+
+    /** A linear ramp like juce::SmoothedValue's, except that the ramp in progress can be stretched to a new sample
+    *   rate, where SmoothedValue::reset() would jump to its target.
+    */
+    struct Ramp
+    {
+        void reset (int newRampSteps) noexcept
+        {
+            rampSteps = newRampSteps;
+            setCurrentAndTargetValue (target);
+        }
+
+        void setCurrentAndTargetValue (T value) noexcept
+        {
+            current = target = value;
+            stepsLeft = 0;
+        }
+
+        void setTargetValue (T value) noexcept
+        {
+            if (value == target)
+                return;
+
+            if (rampSteps <= 0)
+                return setCurrentAndTargetValue (value);
+
+            target = value;
+            stepsLeft = rampSteps;
+            step = (target - current) / T (stepsLeft);
+        }
+
+        T getNextValue () noexcept
+        {
+            if (stepsLeft <= 0)
+                return target;
+
+            current = --stepsLeft > 0 ? current + step : target;
+            return current;
+        }
+
+        /** The same as numSteps calls to getNextValue(). */
+        void skip (int numSteps) noexcept
+        {
+            if (numSteps >= stepsLeft)
+                return setCurrentAndTargetValue (target);
+
+            stepsLeft -= numSteps;
+            current += step * T (numSteps);
+        }
+
+        T getCurrentValue () const noexcept { return stepsLeft > 0 ? current : target; }
+
+        bool isSmoothing () const noexcept { return stepsLeft > 0; }
+
+        /** For a sample rate ratio times higher: what's left of the current ramp takes ratio times more steps, and the
+        *   next ramps take newRampSteps.
+        */
+        void rescale (double ratio, int newRampSteps) noexcept
+        {
+            rampSteps = newRampSteps;
+
+            if (stepsLeft > 0)
+            {
+                stepsLeft = juce::jmax (1, juce::roundToInt (stepsLeft * ratio));
+                step = (target - current) / T (stepsLeft);
+            }
+        }
+
+        T current { 440 }, target { 440 }, step { 0 };
+        int stepsLeft = 0, rampSteps = 0;
+    };
+
+    std::function<T (T)> generator;
+    std::unique_ptr<juce::dsp::LookupTableTransform<T>> lookupTable;
+    std::atomic<const MipmappedWavetable<T>*> wavetable { nullptr };
+
+    Ramp frequency;
+    double sampleRate { 48000. }, phase { 0. };
+    bool oddCycle { false };    //every other cycle, for the sub octave phases
+    OscShape::Values bandLimitedShape { OscShape::none };
+
+    //the band-limited shapes and wavetables are computed this many samples at a time
+    static constexpr size_t chunkSize { (size_t) Constants::processingQuantum };
+};
+
+//====================================================================================================
+
+template <std::floating_point T>
+void ProPhatOscillator<T>::addShape (T* samples, const T* phases, const T* increments, T maxIncrement, size_t num, T gain) const noexcept
+{
+    if (const auto* table { wavetable.load (std::memory_order_relaxed) })
+    {
+        //the level is picked once per chunk, for the highest frequency in it, so a glide up never aliases
+        const auto* level { table->getLevel (maxIncrement) };
+
+        for (size_t i = 0; i < num; ++i)
+            samples[i] += gain * MipmappedWavetable<T>::getSample (level, phases[i]);
+
+        return;
+    }
+
+    switch (bandLimitedShape)
+    {
+        case OscShape::saw:         addBandLimited<OscShape::saw> (samples, phases, increments, num, gain); break;
+        case OscShape::sawTri:      addBandLimited<OscShape::sawTri> (samples, phases, increments, num, gain); break;
+        case OscShape::triangle:    addBandLimited<OscShape::triangle> (samples, phases, increments, num, gain); break;
+        case OscShape::pulse:       addBandLimited<OscShape::pulse> (samples, phases, increments, num, gain); break;
+        default:                    jassertfalse; break;
+    }
+}
+
+template <std::floating_point T>
+template <OscShape::Values shape>
+void ProPhatOscillator<T>::addBandLimited (T* samples, const T* phases, const T* increments, size_t num, T gain) noexcept
+{
+    //the shape is computed for the whole chunk at once, which vectorises
+    for (size_t i = 0; i < num; ++i)
+        samples[i] += gain * PolyBlep::getSample<shape> (phases[i], increments[i]);
+}
+
+template <std::floating_point T>
+T ProPhatOscillator<T>::getNextPhases (T* phases, T* increments, size_t num, T* subPhases) noexcept
+{
+    auto maxIncrement { T (0) };
+
+    //the phase is still accumulated in double, one sample at a time, but handed to the shapes in cycles
+    for (size_t i = 0; i < num; ++i)
+    {
+        const auto increment { getIncrement (frequency.getNextValue ()) };
+        phases[i] = static_cast<T> (phase / twoPi);
+        increments[i] = static_cast<T> (increment / twoPi);
+        maxIncrement = juce::jmax (maxIncrement, increments[i]);
+
+        //an octave below, a cycle of ours is half a cycle
+        if (subPhases != nullptr)
+            subPhases[i] = (phases[i] + (oddCycle ? T (1) : T (0))) * T (.5);
+
+        advance (increment);
+    }
+
+    return maxIncrement;
+}
@@ -26,8 +26,8 @@
 ProPhatProcessor::ProPhatProcessor()
     : juce::AudioProcessor (BusesProperties().withOutput ("Output", juce::AudioChannelSet::stereo(), true))
     , state { constructState () }
-    , proPhatSynthFloat (state)
-    , proPhatSynthDouble (state)
+    , proPhatSynthFloat (state, tuning)
+    , proPhatSynthDouble (state, tuning)
 #if CPU_USAGE
     , perfCounter ("ProcessBlock")
 #endif
@@ -36,10 +36,33 @@ ProPhatProcessor::ProPhatProcessor()
 
 void ProPhatProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    if (isUsingDoublePrecision ())
+    midiCoalescer.prepare (Constants::processingQuantum);
+
+    if (isUsingDoubleEngine ())
+    {
         proPhatSynthDouble.prepare ({ sampleRate, (juce::uint32) samplesPerBlock, 2 });
+    }
     else
+    {
         proPhatSynthFloat.prepare ({ sampleRate, (juce::uint32) samplesPerBlock, 2 });
+
+        if (isUsingDoublePrecision ())
+        {
+            floatEngineBuffer.setSize (2, samplesPerBlock);
+            floatEngineMidi.ensureSize (4096);
+        }
+    }
+
+    prepared = true;
+}
+
+void ProPhatProcessor::setDoubleHostEngine (DoubleHostEngine engine)
+{
+    //only the engine in use was prepared, so switching now would render with an unprepared one
+    jassert (! prepared);
+
+    if (! prepared)
+        doubleHostEngine = engine;
 }
 
 juce::AudioProcessorValueTreeState ProPhatProcessor::constructState ()
@@ -67,6 +90,7 @@ juce::AudioProcessorValueTreeState ProPhatProcessor::constructState ()
 
         std::make_unique<juce::AudioParameterFloat>  (filterCutoffID, filterCutoffID.getParamID (), cutOffRange, defaultFilterCutoff),
         std::make_unique<juce::AudioParameterFloat>  (filterResonanceID, filterResonanceID.getParamID (), sliderRange, defaultFilterResonance),
+        std::make_unique<juce::AudioParameterChoice> (filterTypeID, filterTypeID.getParamID (), juce::StringArray { filterType0, filterType1, filterType2, filterType3 }, defaultFilterType),
 
         std::make_unique<juce::AudioParameterFloat>  (ampAttackID, ampAttackID.getParamID (), attackRange, defaultAmpA),
         std::make_unique<juce::AudioParameterFloat>  (ampDecayID, ampDecayID.getParamID (), decayRange, defaultAmpD),
@@ -86,7 +110,16 @@ juce::AudioProcessorValueTreeState ProPhatProcessor::constructState ()
         std::make_unique<juce::AudioParameterFloat>  (effectParam1ID, effectParam1ID.getParamID (), sliderRange, defaultEffectParam1),
         std::make_unique<juce::AudioParameterFloat>  (effectParam2ID, effectParam2ID.getParamID (), sliderRange, defaultEffectParam2),
 
-        std::make_unique<juce::AudioParameterFloat>  (masterGainID, masterGainID.getParamID (), sliderRange, defaultMasterGain)
+        std::make_unique<juce::AudioParameterFloat>  (masterGainID, masterGainID.getParamID (), sliderRange, defaultMasterGain),
+
+        std::make_unique<juce::AudioParameterChoice> (voiceModeID, voiceModeID.getParamID (), juce::StringArray { voiceMode0, voiceMode1, voiceMode2 }, defaultVoiceMode),
+        std::make_unique<juce::AudioParameterFloat>  (glideID, glideID.getParamID (), glideRange, defaultGlideTime),
+
+        std::make_unique<juce::AudioParameterChoice> (oversamplingID, oversamplingID.getParamID (), juce::StringArray { oversampling0, oversampling1, oversampling2, oversampling3 }, defaultOversampling),
+
+        std::make_unique<juce::AudioParameterInt>    (unisonVoicesID, unisonVoicesID.getParamID (), unisonVoicesRange.getRange ().getStart (), unisonVoicesRange.getRange ().getEnd (), defaultUnisonVoices),
+        std::make_unique<juce::AudioParameterFloat>  (unisonDetuneID, unisonDetuneID.getParamID (), sliderRange, defaultUnisonDetune),
+        std::make_unique<juce::AudioParameterFloat>  (unisonSpreadID, unisonSpreadID.getParamID (), sliderRange, defaultUnisonSpread)
     }};
 }
 
@@ -107,7 +140,34 @@ void ProPhatProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::Mid
 void ProPhatProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
 {
     jassert (isUsingDoublePrecision());
-    process (buffer, midiMessages);
+
+    if (isUsingDoubleEngine ())
+    {
+        process (buffer, midiMessages);
+        return;
+    }
+
+    //render with the float engine, and only convert its output. Hosts can send bigger blocks than they said they
+    //would, so these are rendered in slices the size of floatEngineBuffer rather than growing it on the audio thread
+    const auto sliceSize { floatEngineBuffer.getNumSamples () };
+    const auto numChannels { juce::jmin (buffer.getNumChannels (), floatEngineBuffer.getNumChannels ()) };
+    jassert (sliceSize > 0 && numChannels == buffer.getNumChannels ());
+
+    if (sliceSize == 0)
+        return buffer.clear ();
+
+    for (int start = 0; start < buffer.getNumSamples (); start += sliceSize)
+    {
+        const auto numSamples { juce::jmin (sliceSize, buffer.getNumSamples () - start) };
+        juce::AudioBuffer<float> slice (floatEngineBuffer.getArrayOfWritePointers (), numChannels, numSamples);
+
+        floatEngineMidi.clear ();
+        floatEngineMidi.addEvents (midiMessages, start, numSamples, -start);
+        process (slice, floatEngineMidi);
+
+        for (int c = 0; c < numChannels; ++c)
+            std::copy_n (slice.getReadPointer (c), numSamples, buffer.getWritePointer (c, start));
+    }
 }
 
 template <std::floating_point T>
@@ -131,8 +191,23 @@ void ProPhatProcessor::process (juce::AudioBuffer<T>& buffer, juce::MidiBuffer&
         }
     }
 
+    //fold dense controller streams onto the synth's quantum boundaries, so they don't chop the block into tiny sub-blocks
+    if constexpr (std::is_same_v<T, double>)
+        midiCoalescer.process (midiMessages, buffer.getNumSamples (), proPhatSynthDouble.getQuantumPosition ());
+    else
+        midiCoalescer.process (midiMessages, buffer.getNumSamples (), proPhatSynthFloat.getQuantumPosition ());
+
+    //pick up a tuning loaded since the last block
+    if (tuning.update ())
+    {
+        if constexpr (std::is_same_v<T, double>)
+            proPhatSynthDouble.retune ();
+        else
+            proPhatSynthFloat.retune ();
+    }
+
     //render the block
-    if (isUsingDoublePrecision())
+    if constexpr (std::is_same_v<T, double>)
         proPhatSynthDouble.renderNextBlock (buffer, midiMessages, 0, buffer.getNumSamples());
     else
         proPhatSynthFloat.renderNextBlock (buffer, midiMessages, 0, buffer.getNumSamples());
@@ -151,7 +226,60 @@ void ProPhatProcessor::getStateInformation (juce::MemoryBlock& destData)
 void ProPhatProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     if (auto xmlState { getXmlFromBinary (data, sizeInBytes) })
+    {
         state.replaceState (juce::ValueTree::fromXml (*xmlState));
+        restoreTuning ();
+    }
+}
+
+juce::Result ProPhatProcessor::loadTuning (const juce::String& scl, const juce::String& kbm)
+{
+    const auto result { tuning.loadScala (scl, kbm) };
+
+    if (result.wasOk ())
+    {
+        state.state.setProperty (tuningSclProperty, scl, nullptr);
+        state.state.setProperty (tuningKbmProperty, kbm, nullptr);
+    }
+
+    return result;
+}
+
+void ProPhatProcessor::resetTuning ()
+{
+    tuning.resetToEqualTemperament ();
+
+    state.state.removeProperty (tuningSclProperty, nullptr);
+    state.state.removeProperty (tuningKbmProperty, nullptr);
+}
+
+void ProPhatProcessor::setVoiceRetireThreshold (float thresholdDb)
+{
+    proPhatSynthFloat.setVoiceRetireThreshold (thresholdDb);
+    proPhatSynthDouble.setVoiceRetireThreshold (thresholdDb);
+}
+
+int ProPhatProcessor::getNumActiveVoices () const
+{
+    return isUsingDoubleEngine () ? proPhatSynthDouble.getNumActiveVoices () : proPhatSynthFloat.getNumActiveVoices ();
+}
+
+int ProPhatProcessor::getNumDroppedNoteOns () const
+{
+    return isUsingDoubleEngine () ? proPhatSynthDouble.getNumDroppedNoteOns () : proPhatSynthFloat.getNumDroppedNoteOns ();
+}
+
+int ProPhatProcessor::getNumPendingNoteOns () const
+{
+    return isUsingDoubleEngine () ? proPhatSynthDouble.getNumPendingNoteOns () : proPhatSynthFloat.getNumPendingNoteOns ();
+}
+
+void ProPhatProcessor::restoreTuning ()
+{
+    const auto scl { state.state.getProperty (tuningSclProperty).toString () };
+
+    if (scl.isEmpty () || tuning.loadScala (scl, state.state.getProperty (tuningKbmProperty).toString ()).failed ())
+        tuning.resetToEqualTemperament ();
 }
 
 juce::AudioProcessorEditor* ProPhatProcessor::createEditor()
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "../Utility/Macros.h"
+#include "MidiControllerCoalescer.h"
 #include "ProPhatSynthesiser.h"
 
 /** The main AudioProcessor for the plugin.
@@ -35,9 +36,24 @@ public:
 
     bool supportsDoublePrecisionProcessing () const override { return true; }
 
+    /** Which synthesiser renders for double precision hosts. The float engine sounds the same for a fraction of the
+    *   cost, and its output is only converted to double in the host buffer.
+    */
+    enum class DoubleHostEngine
+    {
+        doubleEngine = 0,
+        floatEngine,
+    };
+
+    /** Selects the engine used by double precision hosts. Only that one gets prepared, so this needs to be called
+    *   before prepareToPlay(), and is ignored after it until releaseResources().
+    */
+    void setDoubleHostEngine (DoubleHostEngine engine);
+    DoubleHostEngine getDoubleHostEngine () const { return doubleHostEngine; }
+
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void reset () override {}
-    void releaseResources () override {}
+    void releaseResources () override { prepared = false; }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
@@ -72,6 +88,26 @@ public:
     */
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    /** Loads a Scala tuning, from the contents of a .scl file and an optional .kbm file. The tuning is saved with the
+    *   state, and playing notes move to it at the start of the next block. On failure, the current tuning is kept.
+    */
+    juce::Result loadTuning (const juce::String& scl, const juce::String& kbm = {});
+
+    /** Goes back to 12-TET, with A at 440 Hz. */
+    void resetTuning ();
+
+    /** Sets the level under which releasing voices are retired, in both engines, see ProPhatVoice::setRetireThreshold(). */
+    void setVoiceRetireThreshold (float thresholdDb);
+
+    /** The number of voices playing or releasing a note, in the engine in use. */
+    int getNumActiveVoices () const;
+
+    /** The note-ons the engine in use dropped, see ProPhatSynthesiser::getNumDroppedNoteOns(). */
+    int getNumDroppedNoteOns () const;
+
+    /** The note-ons waiting in the backlog of the engine in use, see ProPhatSynthesiser::getNumPendingNoteOns(). */
+    int getNumPendingNoteOns () const;
+
     juce::AudioProcessorValueTreeState state;
 
 #if CPU_USAGE
@@ -87,10 +123,31 @@ public:
     juce::ListenerList<MidiMessageListener> midiListeners;
 
 private:
+    MidiControllerCoalescer midiCoalescer;
+
+    //shared by both engines, so it needs to be declared before them
+    TuningTable tuning;
+
     ProPhatSynthesiser<float> proPhatSynthFloat;
     ProPhatSynthesiser<double> proPhatSynthDouble;
 
+    DoubleHostEngine doubleHostEngine { RENDER_DOUBLE_HOSTS_IN_FLOAT ? DoubleHostEngine::floatEngine : DoubleHostEngine::doubleEngine };
+
+    //what the float engine renders into for double precision hosts, a slice of the host block at a time
+    juce::AudioBuffer<float> floatEngineBuffer;
+    juce::MidiBuffer floatEngineMidi;
+
+    bool prepared = false;
+
+    bool isUsingDoubleEngine () const { return isUsingDoublePrecision () && doubleHostEngine == DoubleHostEngine::doubleEngine; }
+
     juce::AudioProcessorValueTreeState constructState ();
 
+    //the Scala files of the current tuning are kept as properties of the state, so they are saved with it
+    static inline const juce::Identifier tuningSclProperty { "tuningScl" }, tuningKbmProperty { "tuningKbm" };
+
+    /** Loads the tuning saved in the state, or 12-TET if there isn't one. */
+    void restoreTuning ();
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProPhatProcessor)
 };
@@ -24,6 +24,7 @@
 
 #include "ProPhatVoice.h"
 #include "PhatVerb.h"
+#include "../Utility/AlignedArena.h"
 #include "../Utility/Helpers.h"
 
 /** The main Synthesiser for the plugin. It uses Constants::numVoices voices (of type ProPhatVoice),
@@ -35,7 +36,8 @@ class ProPhatSynthesiser : public juce::Synthesiser
                          , public juce::AudioProcessorValueTreeState::Listener
 {
 public:
-    ProPhatSynthesiser(juce::AudioProcessorValueTreeState& processorState);
+    ProPhatSynthesiser (juce::AudioProcessorValueTreeState& processorState, const TuningTable& tuningTable);
+    ~ProPhatSynthesiser () override;
 
     void addParamListenersToState ();
 
@@ -45,7 +47,43 @@ public:
 
     void setMasterGain (float gain) { fxChain.template get<masterGainIndex>().setGainLinear (static_cast<T> (gain)); }
 
+    /** Sets the level under which releasing voices are retired, see ProPhatVoice::setRetireThreshold(). */
+    void setVoiceRetireThreshold (float thresholdDb)
+    {
+        for (auto* v : voices)
+            dynamic_cast<ProPhatVoice<T>*> (v)->setRetireThreshold (thresholdDb);
+    }
+
+    /** The number of voices playing or releasing a note. */
+    int getNumActiveVoices () const
+    {
+        return (int) std::count_if (voices.begin (), voices.end (), [] (const auto* v) { return v->isVoiceActive (); });
+    }
+
+    /** How far into its current processing quantum the next block starts. */
+    int getQuantumPosition () const { return Constants::processingQuantum - quantumSamplesLeft; }
+
+    /** Moves all playing notes to their pitch in the TuningTable, after it changed. */
+    void retune ()
+    {
+        for (auto* v : voices)
+            dynamic_cast<ProPhatVoice<T>*> (v)->retune ();
+    }
+
     void noteOn (const int midiChannel, const int midiNoteNumber, const float velocity) override;
+    void noteOff (const int midiChannel, const int midiNoteNumber, const float velocity, bool allowTailOff) override;
+    void allNotesOff (const int midiChannel, const bool allowTailOff) override;
+
+    /** The number of note-ons that waited more than Constants::maxNoteOnLatencySeconds in the backlog,
+    *   or arrived when it was full, and were dropped.
+    */
+    int getNumDroppedNoteOns () const { return numDroppedNoteOns.load (); }
+
+    /** The number of note-ons waiting in the backlog for kill crossfades to be done. */
+    int getNumPendingNoteOns () const { return numPendingNoteOns.load (); }
+
+    void handlePitchWheel (int midiChannel, int wheelValue) override;
+    void handleController (int midiChannel, int controllerNumber, int controllerValue) override;
 
 private:
     void setEffectParam (juce::StringRef parameterID, float newValue);
@@ -57,9 +95,61 @@ private:
         masterGainIndex,
     };
 
+    /** Starts the backlogged note-ons for which voices are now available, and drops the ones that waited too long. */
+    void startPendingNoteOns (int numSamples);
+
+    /** Picks up a voice mode change from the parameter. Called on the audio thread. */
+    void updateVoiceMode ();
+
+    /** In mono and legato modes, the one voice that is playing, if any. */
+    ProPhatVoice<T>* getMonoVoice ();
+
+    /** Removes a released key from the held notes, and moves the mono voice back to the last key still held, or
+    *   releases it. Returns false when there was no mono voice to handle it.
+    */
+    bool releaseMonoNote (int midiNoteNumber, float velocity, bool allowTailOff);
+
     //TODO: make this into a bit mask thing?
     std::set<int> voicesBeingKilled;
 
+    //note-ons received while all voices were being killed, started as soon as kill crossfades free up voices
+    struct PendingNoteOn
+    {
+        int midiChannel = 0;
+        int midiNoteNumber = 0;
+        float velocity = 0.f;
+        int samplesWaited = 0;
+    };
+
+    std::array<PendingNoteOn, Constants::maxPendingNoteOns> pendingNoteOns;
+    std::atomic<int> numPendingNoteOns { 0 };
+    int maxNoteOnLatencySamples = 0;
+    std::atomic<int> numDroppedNoteOns { 0 };
+
+    //in mono and legato modes, a single voice is moved from note to note instead of starting a new one. The keys
+    //still held are kept in order, so releasing the last one goes back to the previous one
+    std::atomic<int> voiceMode { Constants::defaultVoiceMode };
+    int activeVoiceMode = Constants::defaultVoiceMode;
+
+    struct HeldNote
+    {
+        int midiNoteNumber = 0;
+        float velocity = 0.f;
+    };
+
+    std::array<HeldNote, Constants::maxMonoHeldNotes> monoHeldNotes;
+    int numMonoHeldNotes = 0;
+
+    //pitch wheel and tilt for each midi channel, shared by all voices
+    ChannelControllerStates channelControllerStates;
+
+    //the voices live back to back in voiceArena, and their scratch buffers in scratchArena, one voice after the other
+    AlignedArena voiceArena, scratchArena;
+
+    //the filters of all the voices, run together once per quantum, see renderVoices()
+    FilterBank<T> filterBank;
+    int quantumSamplesLeft = Constants::processingQuantum;
+
     juce::dsp::ProcessorChain<PhatVerbWrapper<T>, juce::dsp::Gain<T>> fxChain;
     PhatVerbParameters reverbParams
     {
@@ -76,7 +166,7 @@ private:
 
     juce::AudioProcessorValueTreeState& state;
 
-    juce::dsp::ProcessSpec curSpecs;
+    juce::dsp::ProcessSpec curSpecs {};
 };
 
 //=====================================================================================================================
@@ -84,8 +174,36 @@ private:
 template <std::floating_point T>
 void ProPhatSynthesiser<T>::renderVoices (juce::AudioBuffer<T>& outputAudio, int startSample, int numSamples)
 {
-    for (auto* voice : voices)
-        voice->renderNextBlock (outputAudio, startSample, numSamples);
+    updateVoiceMode ();
+
+    if (numPendingNoteOns > 0)
+        startPendingNoteOns (numSamples);
+
+    //the voices render a quantum at a time, all in step, so their filters can run together in filterBank
+    for (int pos = 0; pos < numSamples;)
+    {
+        const auto subBlockSize { juce::jmin (numSamples - pos, quantumSamplesLeft) };
+
+        for (auto* v : voices)
+        {
+            if (auto* voice { dynamic_cast<ProPhatVoice<T>*> (v) }; voice->isRendering ())
+            {
+                voice->alignQuantum (quantumSamplesLeft);
+                voice->renderOscillators (subBlockSize, filterBank);
+            }
+        }
+
+        filterBank.flush ();
+
+        for (auto* v : voices)
+            if (auto* voice { dynamic_cast<ProPhatVoice<T>*> (v) }; voice->isRendering ())
+                voice->renderAfterFilters (outputAudio, startSample + pos, subBlockSize);
+
+        pos += subBlockSize;
+        quantumSamplesLeft -= subBlockSize;
+        if (quantumSamplesLeft == 0)
+            quantumSamplesLeft = Constants::processingQuantum;
+    }
 
     auto audioBlock { juce::dsp::AudioBlock<T> (outputAudio).getSubBlock((size_t)startSample, (size_t)numSamples) };
     const auto context { juce::dsp::ProcessContextReplacing<T> (audioBlock) };
@@ -93,14 +211,21 @@ void ProPhatSynthesiser<T>::renderVoices (juce::AudioBuffer<T>& outputAudio, int
 }
 
 template <std::floating_point T>
-ProPhatSynthesiser<T>::ProPhatSynthesiser (juce::AudioProcessorValueTreeState& processorState)
+ProPhatSynthesiser<T>::ProPhatSynthesiser (juce::AudioProcessorValueTreeState& processorState, const TuningTable& tuningTable)
 : state (processorState)
 {
+    voiceArena.reset (Constants::numVoices * AlignedArena::getAllocationSize<ProPhatVoice<T>> (1));
+
     for (auto i = 0; i < Constants::numVoices; ++i)
-        addVoice (new ProPhatVoice<T> (state, i, &voicesBeingKilled));
+        addVoice (new (voiceArena.allocate<ProPhatVoice<T>> (1)) ProPhatVoice<T> (state, i, &voicesBeingKilled, &channelControllerStates, tuningTable));
 
     addSound (new ProPhatSound ());
 
+    //juce::Synthesiser only splits blocks at midi events more than 32 samples apart, and moves the others earlier. Our
+    //voices keep their quantum across renderNextBlock calls, so sub-blocks of any size cost them nothing extra, and
+    //notes can start on their exact sample
+    setMinimumRenderingSubdivisionSize (1);
+
     addParamListenersToState ();
 
     setMasterGain (Constants::defaultMasterGain);
@@ -110,6 +235,16 @@ ProPhatSynthesiser<T>::ProPhatSynthesiser (juce::AudioProcessorValueTreeState& p
     fxChain.template get<reverbIndex> ().setParameters (reverbParams);
 }
 
+template <std::floating_point T>
+ProPhatSynthesiser<T>::~ProPhatSynthesiser ()
+{
+    //the voices were placement-new'd into voiceArena, so we destroy them ourselves instead of letting the base class delete them
+    for (auto* v : voices)
+        v->~SynthesiserVoice ();
+
+    voices.clear (false);
+}
+
 template <std::floating_point T>
 void ProPhatSynthesiser<T>::addParamListenersToState ()
 {
@@ -119,6 +254,8 @@ void ProPhatSynthesiser<T>::addParamListenersToState ()
     state.addParameterListener (effectParam2ID.getParamID (), this);
 
     state.addParameterListener (masterGainID.getParamID (), this);
+
+    state.addParameterListener (voiceModeID.getParamID (), this);
 }
 
 template <std::floating_point T>
@@ -129,10 +266,16 @@ void ProPhatSynthesiser<T>::prepare (const juce::dsp::ProcessSpec& spec) noexcep
 
     curSpecs = spec;
 
+    maxNoteOnLatencySamples = (int) (spec.sampleRate * Constants::maxNoteOnLatencySeconds);
+
     setCurrentPlaybackSampleRate (spec.sampleRate);
 
+    scratchArena.reset ((size_t) voices.size () * ProPhatVoice<T>::getArenaSize (spec));
+
     for (auto* v : voices)
-        dynamic_cast<ProPhatVoice<T>*> (v)->prepare (spec);
+        dynamic_cast<ProPhatVoice<T>*> (v)->prepare (spec, scratchArena);
+
+    jassert (scratchArena.getNumBytesUsed () == scratchArena.getSize ());
 
     fxChain.prepare (spec);
 }
@@ -148,6 +291,8 @@ void ProPhatSynthesiser<T>::parameterChanged (const juce::String& parameterID, f
         setEffectParam (parameterID, newValue);
     else if (parameterID == masterGainID.getParamID ())
         setMasterGain (newValue);
+    else if (parameterID == voiceModeID.getParamID ())
+        voiceMode.store ((int) newValue);
     else
         jassertfalse;
 }
@@ -169,10 +314,184 @@ void ProPhatSynthesiser<T>::setEffectParam ([[maybe_unused]] juce::StringRef par
 template <std::floating_point T>
 void ProPhatSynthesiser<T>::noteOn (const int midiChannel, const int midiNoteNumber, const float velocity)
 {
-    //don't start new voices in current buffer call if we have filled all voices already.
-    //voicesBeingKilled should be reset after each renderNextBlock call
-    if (voicesBeingKilled.size() >= Constants::numVoices)
+    updateVoiceMode ();
+
+    if (activeVoiceMode != VoiceMode::poly)
+    {
+        //remember the key, dropping the oldest one if too many are held
+        if (numMonoHeldNotes == Constants::maxMonoHeldNotes)
+            std::move (monoHeldNotes.begin () + 1, monoHeldNotes.end (), monoHeldNotes.begin ());
+        else
+            ++numMonoHeldNotes;
+
+        monoHeldNotes[(size_t) numMonoHeldNotes - 1] = { midiNoteNumber, velocity };
+
+        //move the playing voice to the new note. In legato mode the envelopes only restart when no other key was held
+        if (auto* voice { getMonoVoice () })
+        {
+            const auto isLegato { activeVoiceMode == VoiceMode::legato && numMonoHeldNotes > 1 && ! voice->isReleasing () };
+            voice->retargetNote (midiNoteNumber, velocity, ! isLegato);
+            voice->setKeyDown (true);
+            return;
+        }
+
+        //no voice is playing, so start one the regular way
+    }
+
+    //notes still in the backlog came first
+    if (numPendingNoteOns > 0)
+        startPendingNoteOns (0);
+
+    //don't start new voices in current buffer call if we have filled all voices already, or if older notes are
+    //still waiting. Instead the note waits in the backlog, behind them, until kill crossfades are done
+    if (numPendingNoteOns > 0 || voicesBeingKilled.size() >= Constants::numVoices)
+    {
+        if (numPendingNoteOns < Constants::maxPendingNoteOns)
+            pendingNoteOns[(size_t) numPendingNoteOns++] = { midiChannel, midiNoteNumber, velocity, 0 };
+        else
+            ++numDroppedNoteOns;
+
         return;
+    }
 
     Synthesiser::noteOn (midiChannel, midiNoteNumber, velocity);
 }
+
+template <std::floating_point T>
+void ProPhatSynthesiser<T>::noteOff (const int midiChannel, const int midiNoteNumber, const float velocity, bool allowTailOff)
+{
+    updateVoiceMode ();
+
+    if (activeVoiceMode != VoiceMode::poly && releaseMonoNote (midiNoteNumber, velocity, allowTailOff))
+        return;
+
+    //a note released before it could start is simply never started
+    for (int i = numPendingNoteOns; --i >= 0;)
+    {
+        const auto& pending { pendingNoteOns[(size_t) i] };
+        if (pending.midiChannel == midiChannel && pending.midiNoteNumber == midiNoteNumber)
+        {
+            std::move (pendingNoteOns.begin () + i + 1, pendingNoteOns.begin () + numPendingNoteOns, pendingNoteOns.begin () + i);
+            --numPendingNoteOns;
+            return;
+        }
+    }
+
+    Synthesiser::noteOff (midiChannel, midiNoteNumber, velocity, allowTailOff);
+}
+
+template <std::floating_point T>
+void ProPhatSynthesiser<T>::allNotesOff (const int midiChannel, const bool allowTailOff)
+{
+    numPendingNoteOns = 0;
+    numMonoHeldNotes = 0;
+
+    Synthesiser::allNotesOff (midiChannel, allowTailOff);
+}
+
+template <std::floating_point T>
+void ProPhatSynthesiser<T>::updateVoiceMode ()
+{
+    const auto newVoiceMode { voiceMode.load () };
+    if (newVoiceMode == activeVoiceMode)
+        return;
+
+    //notes started in one mode aren't tracked the same way in the other, so release them all
+    allNotesOff (0, true);
+    activeVoiceMode = newVoiceMode;
+}
+
+template <std::floating_point T>
+ProPhatVoice<T>* ProPhatSynthesiser<T>::getMonoVoice ()
+{
+    //voices being killed have already cleared their note, so they aren't active anymore
+    for (auto* v : voices)
+        if (v->isVoiceActive ())
+            return dynamic_cast<ProPhatVoice<T>*> (v);
+
+    return nullptr;
+}
+
+template <std::floating_point T>
+bool ProPhatSynthesiser<T>::releaseMonoNote (int midiNoteNumber, float velocity, bool allowTailOff)
+{
+    const auto wasPlaying { numMonoHeldNotes > 0 && monoHeldNotes[(size_t) numMonoHeldNotes - 1].midiNoteNumber == midiNoteNumber };
+
+    for (int i = numMonoHeldNotes; --i >= 0;)
+    {
+        if (monoHeldNotes[(size_t) i].midiNoteNumber == midiNoteNumber)
+        {
+            std::move (monoHeldNotes.begin () + i + 1, monoHeldNotes.begin () + numMonoHeldNotes, monoHeldNotes.begin () + i);
+            --numMonoHeldNotes;
+            break;
+        }
+    }
+
+    auto* voice { getMonoVoice () };
+    if (voice == nullptr)
+        return false;
+
+    if (! wasPlaying)
+        return true;
+
+    //go back to the last key still held, like a real mono synth
+    if (numMonoHeldNotes > 0)
+    {
+        const auto& held { monoHeldNotes[(size_t) numMonoHeldNotes - 1] };
+        voice->retargetNote (held.midiNoteNumber, held.velocity, activeVoiceMode == VoiceMode::mono);
+        return true;
+    }
+
+    //the sustain pedal is handled by juce::Synthesiser, which stops voices whose key is up when the pedal is released
+    voice->setKeyDown (false);
+
+    if (! voice->isSustainPedalDown () && ! voice->isSostenutoPedalDown () && ! voice->isReleasing ())
+        stopVoice (voice, velocity, allowTailOff);
+
+    return true;
+}
+
+template <std::floating_point T>
+void ProPhatSynthesiser<T>::startPendingNoteOns (int numSamples)
+{
+    //start what we can, in the order the notes came in
+    auto numStarted { 0 };
+    while (numStarted < numPendingNoteOns && voicesBeingKilled.size() < Constants::numVoices)
+    {
+        const auto& pending { pendingNoteOns[(size_t) numStarted++] };
+        Synthesiser::noteOn (pending.midiChannel, pending.midiNoteNumber, pending.velocity);
+    }
+
+    //then age the others, dropping the ones that have waited too long
+    auto numKept { 0 };
+    for (int i = numStarted; i < numPendingNoteOns; ++i)
+    {
+        auto pending { pendingNoteOns[(size_t) i] };
+        pending.samplesWaited += numSamples;
+
+        if (pending.samplesWaited > maxNoteOnLatencySamples)
+            ++numDroppedNoteOns;
+        else
+            pendingNoteOns[(size_t) numKept++] = pending;
+    }
+
+    numPendingNoteOns = numKept;
+}
+
+template <std::floating_point T>
+void ProPhatSynthesiser<T>::handlePitchWheel (int midiChannel, int wheelValue)
+{
+    //computed once here, the voices pick it up at their next control tick
+    if (midiChannel > 0 && midiChannel <= (int) channelControllerStates.size ())
+        channelControllerStates[(size_t) midiChannel - 1].setPitchWheel (wheelValue);
+}
+
+template <std::floating_point T>
+void ProPhatSynthesiser<T>::handleController (int midiChannel, int controllerNumber, int controllerValue)
+{
+    //1 == orba tilt, which the voices pick up at their next control tick
+    if (controllerNumber == 1 && midiChannel > 0 && midiChannel <= (int) channelControllerStates.size ())
+        channelControllerStates[(size_t) midiChannel - 1].setModWheel (controllerValue);
+    else
+        Synthesiser::handleController (midiChannel, controllerNumber, controllerValue);
+}
@@ -22,6 +22,9 @@
 
 #pragma once
 
+#include "ChannelControllerState.h"
+#include "HalfBandDecimator.h"
+#include "FilterBank.h"
 #include "PhatOscillators.h"
 
 #include "../UI/ButtonGroupComponent.h"
@@ -44,18 +47,17 @@ class ProPhatVoice : public juce::SynthesiserVoice
                    , public juce::AudioProcessorValueTreeState::Listener
 {
 public:
-    enum class ProcessorId
-    {
-        filterIndex = 0,
-        masterGainIndex,
-    };
-
-    ProPhatVoice (juce::AudioProcessorValueTreeState& processorState, int voiceId, std::set<int>* activeVoiceSet);
+    ProPhatVoice (juce::AudioProcessorValueTreeState& processorState, int voiceId, std::set<int>* activeVoiceSet,
+                  const ChannelControllerStates* channelControllerStates, const TuningTable& tuning);
 
     void addParamListenersToState ();
     void parameterChanged (const juce::String& parameterID, float newValue) override;
 
-    void prepare (const juce::dsp::ProcessSpec& spec);
+    /** Prepares the voice, taking all of its scratch buffers out of arena, in render order. */
+    void prepare (const juce::dsp::ProcessSpec& spec, AlignedArena& arena);
+
+    /** The number of arena bytes prepare() will use for this spec. */
+    static size_t getArenaSize (const juce::dsp::ProcessSpec& spec);
 
     void setAmpParam (juce::StringRef parameterID, float newValue);
     void setFilterEnvParam (juce::StringRef parameterID, float newValue);
@@ -71,6 +73,17 @@ public:
         lfoDest.curSelection = dest;
     }
 
+    /** Releasing voices are retired as soon as their amp envelope and output both fall below this threshold,
+    *   instead of rendering until the envelope reaches exactly 0.
+    */
+    void setRetireThreshold (float thresholdDb) { retireThreshold = juce::Decibels::decibelsToGain (static_cast<T> (thresholdDb)); }
+
+    /** Renders the oscillators and the filter at the oversampling factor for cutoff, starting right away, and picks up
+    *   the filter type and whether to bypass the filter. This re-prepares the filter, so it's only for when a note starts.
+    *   Playing notes crossfade instead, see crossfadeToChain().
+    */
+    void startChain (T cutoff);
+
     void setLfoFreq (float newFreq) { lfo.setFrequency (newFreq); }
     void setLfoAmount (float newAmount) { lfoAmount = newAmount; }
 
@@ -80,11 +93,6 @@ public:
         setFilterCutoffInternal (curFilterCutoff + tiltCutoff);
     }
 
-    void setFilterTiltCutoff (T newValue)
-    {
-        tiltCutoff = newValue;
-        setFilterCutoffInternal (curFilterCutoff + tiltCutoff);
-    }
 
     void setFilterResonance (T newAmount)
     {
@@ -92,11 +100,23 @@ public:
         setFilterResonanceInternal (curFilterResonance);
     }
 
-    void pitchWheelMoved (int newPitchWheelValue) override { oscillators.pitchWheelMoved (newPitchWheelValue); }
+    //the pitch wheel and CC1 are handled by ProPhatSynthesiser in the ChannelControllerState, see updateControllers()
+    void pitchWheelMoved (int /*newPitchWheelValue*/) override {}
+    void controllerMoved (int /*controllerNumber*/, int /*newValue*/) override {}
 
     void startNote (int midiNoteNumber, float velocity, juce::SynthesiserSound* /*sound*/, int currentPitchWheelPosition) override;
     void stopNote (float /*velocity*/, bool allowTailOff) override;
 
+    /** Moves this playing voice to a new note without restarting it, for the mono and legato voice modes. The oscillators
+    *   glide to the new note, and when retriggerEnvelopes is true the envelopes attack again from their current level.
+    */
+    void retargetNote (int midiNoteNumber, float velocity, bool retriggerEnvelopes);
+
+    bool isReleasing () const { return currentlyReleasingNote; }
+
+    /** Moves the playing note to its pitch in a new tuning, see TuningTable::update(). */
+    void retune () { oscillators.retune (); }
+
     bool canPlaySound (juce::SynthesiserSound* sound) override { return dynamic_cast<ProPhatSound*> (sound) != nullptr; }
 
     //Because renderNextBlock is defined as 2 different prototypes we can't just implement a
@@ -107,11 +127,24 @@ public:
     void renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override;
     void renderNextBlock (juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override;
 
-    void controllerMoved (int controllerNumber, int newValue) override
+    /** ProPhatSynthesiser renders all of its voices together, a quantum at a time, in 2 steps around a FilterBank:
+    *   renderOscillators() queues the filters of this voice in the bank, and once the bank is flushed, renderAfterFilters()
+    *   adds the rest of the voice to the output. numSamples can't go past the end of the current quantum.
+    */
+    void renderOscillators (int numSamples, FilterBank<T>& filterBank);
+    void renderAfterFilters (juce::AudioBuffer<T>& outputBuffer, int startSample, int numSamples);
+
+    /** True when renderNextBlock() has something to render. */
+    bool isRendering () const { return currentlyKillingVoice || isVoiceActive (); }
+
+    /** Moves the next control tick to the synthesiser's, so all of its voices render their quanta in step. This only
+    *   changes anything for voices that just started, or were killed, which renders them on their own.
+    */
+    void alignQuantum (int samplesLeft)
     {
-        //1 == orba tilt. The newValue range [0-127] is converted to [curFilterCutoff, cutOffRange.end]
-        if (controllerNumber == 1)
-            setFilterTiltCutoff (juce::jmap (T (newValue), T (0), T (127), T (curFilterCutoff), T (Constants::cutOffRange.end)));
+        jassert (samplesLeft > 0 && samplesLeft <= Constants::processingQuantum);
+        jassert (crossfadeSamplesLeft == 0 || samplesLeft == quantumSamplesLeft);
+        quantumSamplesLeft = samplesLeft;
     }
 
     int getVoiceId() { return voiceId; }
@@ -126,17 +159,60 @@ private:
     void setFilterCutoffInternal (T curCutOff)
     {
         const auto limitedCutOff { juce::jlimit (T (Constants::cutOffRange.start), T (Constants::cutOffRange.end), curCutOff) };
-        processorChain.template get<(int) ProcessorId::filterIndex> ().setCutoffFrequencyHz (limitedCutOff);
+        for (auto& chain : chains)
+            chain.filter.setCutoffFrequencyHz (limitedCutOff);
     }
 
     void setFilterResonanceInternal (T curResonance)
     {
         const auto limitedResonance { juce::jlimit (T (0), T (1), curResonance) };
-        processorChain.template get<(int) ProcessorId::filterIndex> ().setResonance (limitedResonance);
+        for (auto& chain : chains)
+            chain.filter.setResonance (limitedResonance);
     }
 
+    /** The filter and gain, running at factor times our sample rate on block, between renderOscillators() and renderAfterFilters(). */
+    struct OversampledChain
+    {
+        ProPhatFilter<T> filter;
+        juce::dsp::Gain<T> gain;
+        HalfBandDecimator<T> decimator;
+        juce::dsp::AudioBlock<T> block;
+        int factor = 0;
+        bool filterBypassed = false;
+    };
+
+    void prepareChain (OversampledChain& chain, int newFactor, int newFilterType, bool bypassFilter);
+
+    /** Applies the gain to the block of the chain, which the filter bank already ran through the filter, and returns it
+    *   decimated back to our sample rate.
+    */
+    juce::dsp::AudioBlock<T> processChain (OversampledChain& chain);
+
+    /** The factor the oversampling parameter asks for. In auto, that depends on the note and on the cutoff. */
+    int getTargetOversamplingFactor (T cutoff) const;
+
+    /** True when a filter of type wouldn't touch the sound: a linear one, fully open, without resonance, and with
+    *   nothing that could close it before the next control tick.
+    */
+    bool shouldBypassFilter (T cutoff, int type) const;
+
+    /** Moves a playing note to a new oversampling factor or filter type, or in or out of the filter bypass, crossfading
+    *   to it over the next quantum.
+    */
+    void crossfadeToChain (int newFactor, int newFilterType, bool bypassFilter);
+    juce::dsp::AudioBlock<T> processOversamplingCrossfade (int curBlockSize);
+
     /** Calculate LFO values. Called on the audio thread. */
     inline void updateLfo();
+
+    /** Picks up the pitch wheel and tilt of our channel. Called on the audio thread, once per control tick. */
+    inline void updateControllers();
+    bool isInaudible (const juce::dsp::AudioBlock<T>& block, float ampEnv) const;
+
+    /** True when the whole control path is constant: both envelopes in sustain, no lfo, no ramps or overlap,
+    *   and no controller or parameter change since the last control tick.
+    */
+    bool isInSteadyState ();
     void processRampUp (juce::dsp::AudioBlock<T>& block, int curBlockSize);
     void processKillOverlap (juce::dsp::AudioBlock<T>& block, int curBlockSize);
     void assertForDiscontinuities (juce::AudioBuffer<T>& outputBuffer, int startSample, int numSamples, juce::String dbgPrefix);
@@ -144,13 +220,26 @@ private:
 
     PhatOscillators<T> oscillators;
 
-    std::unique_ptr<juce::AudioBuffer<T>> overlap;
+    juce::AudioBuffer<T> overlap;
     int overlapIndex = -1;
     //TODO replace this currentlyKillingVoice bool with a check in the bitfield that voicesBeingKilled will become
     bool currentlyKillingVoice = false;
     std::set<int>* voicesBeingKilled;
 
-    juce::dsp::ProcessorChain<juce::dsp::LadderFilter<T>, juce::dsp::Gain<T>> processorChain;
+    const ChannelControllerStates* channelControllerStates;
+    const ChannelControllerState* curChannelControllerState = nullptr;
+
+    //the oscillators and the current chain run chains[curChain].factor times faster than the rest of the voice. When that
+    //changes, the other chain keeps running at the previous factor for one quantum, which we crossfade from
+    std::atomic<int> oversampling { Constants::defaultOversampling };
+    std::atomic<int> filterType { Constants::defaultFilterType };
+    std::array<OversampledChain, 2> chains;
+    size_t curChain = 0;
+    int crossfadeSamplesLeft = 0;
+    HalfBandDecimator<T> crossfadeDecimator;
+    HalfBandInterpolator<T> crossfadeInterpolator;
+    juce::dsp::AudioBlock<T> crossfadeBlock;
+    juce::dsp::ProcessSpec quantumSpec {};
     //TODO: use a slider for this
     static constexpr auto envelopeAmount { 2 };
 
@@ -158,14 +247,17 @@ private:
     juce::ADSR::Parameters ampParams { Constants::defaultAmpA, Constants::defaultAmpD, Constants::defaultAmpS, Constants::defaultAmpR };
     juce::ADSR::Parameters filterEnvParams { ampParams };
     bool currentlyReleasingNote = false, justDoneReleaseEnvelope = false;
+    float ampEnvelope = 0.f;
+    T retireThreshold { juce::Decibels::decibelsToGain (static_cast<T> (Constants::defaultVoiceRetireThresholdDb)) };
 
     T curFilterCutoff { Constants::defaultFilterCutoff };
     T curFilterResonance { Constants::defaultFilterResonance };
 
-    //lfo stuff
-    static constexpr auto lfoUpdateRate = 100;
-    int lfoUpdateCounter = lfoUpdateRate;
-    juce::dsp::Oscillator<T> lfo;
+    //lfo stuff. The lfo is updated once per processing quantum
+    static constexpr auto lfoUpdateRate = Constants::processingQuantum;
+    int quantumSamplesLeft = Constants::processingQuantum;
+    T filterEnvelope { 0 };     //latest filter envelope value, applied to the cutoff at the end of each quantum
+    ProPhatOscillator<T> lfo;
     std::mutex lfoMutex;
     T lfoAmount = static_cast<T> (Constants::defaultLfoAmount);
     LfoDest lfoDest;
@@ -179,8 +271,13 @@ private:
     int rampUpSamplesLeft = 0;
 
     T tiltCutoff { 0.f };
+    float lastPitchWheelRatio = 1.f, lastModWheel = 0.f;
+    bool lastModWheelMoved = false;
 
-    int curPreparedSamples = 0;
+    //steady state fast path, see isInSteadyState()
+    bool steadyState = false;
+    T steadyStateGain { 0 };
+    std::atomic<bool> controlParamChanged { false };
 };
 
 //===========================================================================================================
@@ -188,97 +285,169 @@ private:
 template<std::floating_point T>
 void ProPhatVoice<T>::renderNextBlockTemplate (juce::AudioBuffer<T>& outputBuffer, int startSample, int numSamples)
 {
-    if (! currentlyKillingVoice && ! isVoiceActive ())
+    if (! isRendering ())
         return;
 
-    //reserve an audio block of size numSamples. Auvaltool has a tendency to _not_ call prepare before rendering
-    //with new buffer sizes, so just making sure we're not taking more samples than the audio block was prepared with.
-    numSamples = juce::jmin (numSamples, curPreparedSamples);
-    auto currentAudioBlock { oscillators.prepareRender (numSamples) };
-
+    //we render in fixed quanta of Constants::processingQuantum samples, so the host can send us blocks of any size,
+    //including bigger ones than what we were prepared with. A quantum can straddle 2 renderNextBlock calls when
+    //the host or midi events split the block, so quantumSamplesLeft is kept between calls.
     for (int pos = 0; pos < numSamples;)
     {
-        const auto subBlockSize = juce::jmin (numSamples - pos, lfoUpdateCounter);
+        const auto subBlockSize = juce::jmin (numSamples - pos, quantumSamplesLeft);
+
+        //on our own, our filters get a bank to themselves. See ProPhatSynthesiser::renderVoices() for the usual case
+        FilterBank<T> filterBank;
+        renderOscillators (subBlockSize, filterBank);
+        filterBank.flush ();
+        renderAfterFilters (outputBuffer, startSample + pos, subBlockSize);
 
-        //render the oscillators
-        auto oscBlock { oscillators.process (pos, subBlockSize) };
+        //increment our position
+        pos += subBlockSize;
 
-        //render our effects
-        juce::dsp::ProcessContextReplacing<T> oscContext (oscBlock);
-        processorChain.process (oscContext);
+        //no need to render silence once the voice is done
+        if (! isRendering () && overlapIndex < 0)
+            break;
+    }
 
+    if (currentlyKillingVoice)
+        applyKillRamp (outputBuffer, startSample, numSamples);
+#if DEBUG_VOICES
+    else
+        assertForDiscontinuities (outputBuffer, startSample, numSamples, {});
+#endif
+}
+
+template <std::floating_point T>
+void ProPhatVoice<T>::renderOscillators (int numSamples, FilterBank<T>& filterBank)
+{
+    jassert (numSamples <= quantumSamplesLeft);
+
+    auto& chain { chains[curChain] };
+    if (crossfadeSamplesLeft > 0)
+    {
+        //the oscillators stay at the previous rate until the end of the crossfade, and are resampled for the new chain
+        auto& from { chains[1 - curChain] };
+        from.block = oscillators.process (numSamples * from.factor);
+        chain.block = crossfadeBlock.getSubBlock (0, (size_t) (numSamples * juce::jmax (from.factor, chain.factor)));
+
+        if (chain.factor > from.factor)
+        {
+            crossfadeInterpolator.process (from.block, chain.block, chain.factor / from.factor);
+        }
+        else
+        {
+            chain.block.copyFrom (from.block);
+            chain.block = crossfadeDecimator.process (chain.block, from.factor / chain.factor);
+        }
+
+        if (! from.filterBypassed)
+            filterBank.add (from.filter, from.block);
+    }
+    else
+    {
+        chain.block = oscillators.process (numSamples * chain.factor);
+    }
+
+    if (! chain.filterBypassed)
+        filterBank.add (chain.filter, chain.block);
+}
+
+template <std::floating_point T>
+void ProPhatVoice<T>::renderAfterFilters (juce::AudioBuffer<T>& outputBuffer, int startSample, int numSamples)
+{
+    //bring everything back to our sample rate before the envelopes
+    auto oscBlock { crossfadeSamplesLeft > 0 ? processOversamplingCrossfade (numSamples) : processChain (chains[curChain]) };
+
+    if (steadyState)
+    {
+        //nothing moves in the control path, so the amp envelope is just its sustain level
+        oscBlock.multiplyBy (steadyStateGain);
+    }
+    else
+    {
         //apply the enveloppes. We calculate and apply the amp envelope on a sample basis,
         //but for the filter env we increment it on a sample basis but only apply it
-        //once per buffer, just like the LFO -- see below.
-        auto filterEnvelope { 0.f };
+        //once per quantum, just like the LFO -- see below.
+        const auto numChannels { oscBlock.getNumChannels () };
+        for (auto i = 0; i < numSamples; ++i)
         {
-            const auto numChannels { oscBlock.getNumChannels () };
-            for (auto i = 0; i < subBlockSize; ++i)
-            {
-                //calculate and atore filter envelope
-                filterEnvelope = filterADSR.getNextSample ();
+            //calculate and atore filter envelope
+            filterEnvelope = filterADSR.getNextSample ();
 
-                //calculate and apply amp envelope
-                const auto ampEnv = ampADSR.getNextSample ();
-                for (int c = 0; c < numChannels; ++c)
-                    oscBlock.getChannelPointer (c)[i] *= ampEnv;
-            }
+            //calculate and apply amp envelope
+            ampEnvelope = ampADSR.getNextSample ();
+            for (size_t c = 0; c < numChannels; ++c)
+                oscBlock.getChannelPointer (c)[i] *= ampEnvelope;
+        }
 
-            if (currentlyReleasingNote && ! ampADSR.isActive ())
-            {
-                currentlyReleasingNote = false;
-                justDoneReleaseEnvelope = true;
-                stopNote (0.f, false);
+        if (currentlyReleasingNote && (! ampADSR.isActive () || isInaudible (oscBlock, ampEnvelope)))
+        {
+            currentlyReleasingNote = false;
+            justDoneReleaseEnvelope = true;
+            stopNote (0.f, false);
 
 #if DEBUG_VOICES
-                DBG ("\tDEBUG ENVELOPPE DONE");
+            DBG ("\tDEBUG ENVELOPPE DONE");
 #endif
-            }
         }
+    }
 
-        if (rampingUp)
-            processRampUp (oscBlock, (int) subBlockSize);
+    if (rampingUp)
+        processRampUp (oscBlock, (int) numSamples);
 
-        if (overlapIndex > -1)
-            processKillOverlap (oscBlock, (int) subBlockSize);
+    if (overlapIndex > -1)
+        processKillOverlap (oscBlock, (int) numSamples);
 
-        //update our lfos at the end of the block
-        lfoUpdateCounter -= subBlockSize;
-        if (lfoUpdateCounter == 0)
+    //add this chunk to the output buffer
+    juce::dsp::AudioBlock<T> (outputBuffer).getSubBlock ((size_t) startSample, (size_t) numSamples).add (oscBlock);
+
+    //control-rate updates happen at the end of each quantum
+    quantumSamplesLeft -= numSamples;
+    if (quantumSamplesLeft == 0)
+    {
+        quantumSamplesLeft = Constants::processingQuantum;
+
+        //once steady, the control values computed on the previous tick are still valid
+        const auto wasSteadyState { steadyState };
+        steadyState = isInSteadyState ();
+
+        if (! steadyState || ! wasSteadyState)
         {
-            lfoUpdateCounter = lfoUpdateRate;
+            oscillators.updateGlide ();
             updateLfo ();
+            updateControllers ();
+
+            //the glide, the lfo and the pitch wheel only mark the frequencies as dirty, so they are computed once here
+            oscillators.updateFrequencies ();
+
+            //apply our filter envelope once per quantum
+            const auto curCutOff { (curFilterCutoff + tiltCutoff) * (1 + envelopeAmount * filterEnvelope) + lfoCutOffContributionHz };
+            setFilterCutoffInternal (curCutOff);
+
+            //follow the note and the cutoff with our oversampling, the filter type and the filter bypass
+            const auto& chain { chains[curChain] };
+            const auto factor { getTargetOversamplingFactor (curCutOff) };
+            const auto type { filterType.load () };
+            const auto bypassFilter { shouldBypassFilter (curCutOff, type) };
+            if (factor != chain.factor || type != chain.filter.getType () || bypassFilter != chain.filterBypassed)
+                crossfadeToChain (factor, type, bypassFilter);
         }
-
-        //apply our filter envelope once per buffer
-        const auto curCutOff { (curFilterCutoff + tiltCutoff) * (1 + envelopeAmount * filterEnvelope) + lfoCutOffContributionHz };
-        setFilterCutoffInternal (curCutOff);
-
-        //increment our position
-        pos += subBlockSize;
     }
-
-    //add everything to the output buffer
-    juce::dsp::AudioBlock<T> (outputBuffer).getSubBlock ((size_t) startSample, (size_t) numSamples).add (currentAudioBlock);
-
-    if (currentlyKillingVoice)
-        applyKillRamp (outputBuffer, startSample, numSamples);
-#if DEBUG_VOICES
-    else
-        assertForDiscontinuities (outputBuffer, startSample, numSamples, {});
-#endif
 }
 
 template <std::floating_point T>
-ProPhatVoice<T>::ProPhatVoice (juce::AudioProcessorValueTreeState& processorState, int vId, std::set<int>* activeVoiceSet)
+ProPhatVoice<T>::ProPhatVoice (juce::AudioProcessorValueTreeState& processorState, int vId, std::set<int>* activeVoiceSet,
+                               const ChannelControllerStates* channelStates, const TuningTable& tuning)
 : state (processorState)
 , voiceId (vId)
-, oscillators (state)
+, oscillators (state, tuning)
 , voicesBeingKilled (activeVoiceSet)
+, channelControllerStates (channelStates)
 {
     addParamListenersToState ();
 
-    processorChain.template get<(int)ProcessorId::masterGainIndex>().setGainLinear (static_cast<T> (Constants::defaultOscLevel));
+    for (auto& chain : chains)
+        chain.gain.setGainLinear (static_cast<T> (Constants::defaultOscLevel));
 
     setFilterCutoffInternal (Constants::defaultFilterCutoff);
     setFilterResonanceInternal (Constants::defaultFilterResonance);
@@ -290,15 +459,46 @@ ProPhatVoice<T>::ProPhatVoice (juce::AudioProcessorValueTreeState& processorStat
 }
 
 template <std::floating_point T>
-void ProPhatVoice<T>::prepare (const juce::dsp::ProcessSpec& spec)
+size_t ProPhatVoice<T>::getArenaSize (const juce::dsp::ProcessSpec& spec)
 {
-    curPreparedSamples = spec.maximumBlockSize;
-    oscillators.prepare (spec);
+    //the oscillators render a whole quantum at the highest oversampling rate
+    const juce::dsp::ProcessSpec oversampledSpec { spec.sampleRate, (juce::uint32) (Constants::processingQuantum * Constants::maxOversamplingFactor), spec.numChannels };
+
+    return PhatOscillators<T>::getArenaSize (oversampledSpec)
+         + AlignedArena::getAllocationSize<T*> (spec.numChannels)
+         + spec.numChannels * AlignedArena::getAllocationSize<T> (oversampledSpec.maximumBlockSize)
+         + AlignedArena::getAllocationSize<T*> (spec.numChannels)
+         + spec.numChannels * AlignedArena::getAllocationSize<T> (Constants::killRampSamples);
+}
+
+template <std::floating_point T>
+void ProPhatVoice<T>::prepare (const juce::dsp::ProcessSpec& spec, AlignedArena& arena)
+{
+    //everything in the render path only ever sees a single quantum at a time, at most maxOversamplingFactor times longer
+    quantumSpec = { spec.sampleRate, (juce::uint32) Constants::processingQuantum, spec.numChannels };
+    const juce::dsp::ProcessSpec oversampledSpec { spec.sampleRate, quantumSpec.maximumBlockSize * (juce::uint32) Constants::maxOversamplingFactor, spec.numChannels };
+    oscillators.prepare (oversampledSpec, arena);
+
+    //the chain we crossfade to gets the oscillators resampled in here
+    auto crossfadeChannels { arena.allocate<T*> (spec.numChannels) };
+    for (size_t c = 0; c < spec.numChannels; ++c)
+        crossfadeChannels[c] = arena.allocate<T> (oversampledSpec.maximumBlockSize);
+
+    crossfadeBlock = { crossfadeChannels, spec.numChannels, oversampledSpec.maximumBlockSize };
 
-    overlap = std::make_unique<juce::AudioBuffer<T>> (spec.numChannels, Constants::killRampSamples);
-    overlap->clear();
+    //the overlap buffer is only used when the voice is killed, so it goes after the oscillator blocks
+    auto overlapChannels { arena.allocate<T*> (spec.numChannels) };
+    for (size_t c = 0; c < spec.numChannels; ++c)
+        overlapChannels[c] = arena.allocate<T> (Constants::killRampSamples);
 
-    processorChain.prepare (spec);
+    overlap.setDataToReferTo (overlapChannels, (int) spec.numChannels, Constants::killRampSamples);
+    overlap.clear();
+
+    //this prepares the current chain, the other one is prepared when we crossfade to it
+    for (auto& chain : chains)
+        chain.factor = 0;
+
+    startChain (curFilterCutoff);
 
     ampADSR.setSampleRate (spec.sampleRate);
     ampADSR.setParameters (ampParams);
@@ -307,7 +507,132 @@ void ProPhatVoice<T>::prepare (const juce::dsp::ProcessSpec& spec)
     filterADSR.setSampleRate (spec.sampleRate);
     filterADSR.setParameters (filterEnvParams);
 
-    lfo.prepare ({spec.sampleRate / lfoUpdateRate, spec.maximumBlockSize, spec.numChannels});
+    lfo.prepare ({spec.sampleRate / lfoUpdateRate, quantumSpec.maximumBlockSize, spec.numChannels});
+}
+
+template <std::floating_point T>
+void ProPhatVoice<T>::prepareChain (OversampledChain& chain, int newFactor, int newFilterType, bool bypassFilter)
+{
+    jassert (newFactor == 1 || newFactor == 2 || newFactor == Constants::maxOversamplingFactor);
+    chain.factor = newFactor;
+    chain.filterBypassed = bypassFilter;
+
+    //the filter recomputes its coefficients for the new rate and type, and starts again from silence
+    const juce::dsp::ProcessSpec chainSpec { quantumSpec.sampleRate * newFactor, quantumSpec.maximumBlockSize * (juce::uint32) newFactor, quantumSpec.numChannels };
+    chain.filter.setType (newFilterType);
+    chain.filter.prepare (chainSpec);
+    chain.gain.prepare (chainSpec);
+    chain.decimator.reset ();
+}
+
+template <std::floating_point T>
+juce::dsp::AudioBlock<T> ProPhatVoice<T>::processChain (OversampledChain& chain)
+{
+    juce::dsp::ProcessContextReplacing<T> context (chain.block);
+    chain.gain.process (context);
+
+    return chain.decimator.process (chain.block, chain.factor);
+}
+
+template <std::floating_point T>
+void ProPhatVoice<T>::startChain (T cutoff)
+{
+    crossfadeSamplesLeft = 0;
+
+    auto& chain { chains[curChain] };
+    const auto newFactor { getTargetOversamplingFactor (cutoff) };
+    const auto type { filterType.load () };
+    const auto bypassFilter { shouldBypassFilter (cutoff, type) };
+    if (newFactor == chain.factor && type == chain.filter.getType () && bypassFilter == chain.filterBypassed)
+        return;
+
+    prepareChain (chain, newFactor, type, bypassFilter);
+    oscillators.setSampleRate (quantumSpec.sampleRate * newFactor);
+}
+
+template <std::floating_point T>
+int ProPhatVoice<T>::getTargetOversamplingFactor (T cutoff) const
+{
+    const auto mode { oversampling.load () };
+    if (mode != Oversampling::automatic)
+        return 1 << mode;
+
+    //the filter saturates the strongest partials of the note, and what that adds over nyquist folds back.
+    //The filter keeps the partials above the cutoff from getting there, so the cutoff caps how high this goes
+    const auto highest { juce::jmin (oscillators.getHighestFrequency () * T (Constants::adaptiveOversamplingHarmonics), cutoff) };
+    const auto relativeToRate { static_cast<float> (highest / quantumSpec.sampleRate) };
+
+    //a factor we're already at is only dropped a bit under its threshold, so a note sitting right on it doesn't keep
+    //crossfading back and forth
+    const auto curFactor { chains[curChain].factor };
+    const auto threshold = [curFactor] (float fraction, int factor)
+    {
+        return curFactor >= factor ? fraction * Constants::adaptiveOversamplingHysteresis : fraction;
+    };
+
+    if (relativeToRate > threshold (Constants::adaptiveOversampling4xThreshold, 4))
+        return 4;
+
+    if (relativeToRate > threshold (Constants::adaptiveOversampling2xThreshold, 2))
+        return 2;
+
+    return 1;
+}
+
+template <std::floating_point T>
+bool ProPhatVoice<T>::shouldBypassFilter (T cutoff, int type) const
+{
+    if (! ProPhatFilter<T>::isLinear (type) || cutoff < T (Constants::cutOffRange.end) || curFilterResonance > 0)
+        return false;
+
+    //the lfo moves the cutoff and the resonance on every tick, so it could close the filter any time
+    const auto lfoOnFilter { lfoDest.curSelection == LfoDest::filterCutOff || lfoDest.curSelection == LfoDest::filterResonance };
+    return ! (lfoOnFilter && lfoAmount > 0);
+}
+
+template <std::floating_point T>
+void ProPhatVoice<T>::crossfadeToChain (int newFactor, int newFilterType, bool bypassFilter)
+{
+    jassert (crossfadeSamplesLeft == 0);
+
+    //the chain we leave keeps its state, so it carries on seamlessly while it fades out
+    curChain = 1 - curChain;
+    prepareChain (chains[curChain], newFactor, newFilterType, bypassFilter);
+
+    crossfadeDecimator.reset ();
+    crossfadeInterpolator.reset ();
+    crossfadeSamplesLeft = Constants::processingQuantum;
+}
+
+template <std::floating_point T>
+juce::dsp::AudioBlock<T> ProPhatVoice<T>::processOversamplingCrossfade (int curBlockSize)
+{
+    //both chains got their block from renderOscillators()
+    auto& from { chains[1 - curChain] };
+    auto& to { chains[curChain] };
+
+    auto fromBlock { processChain (from) };
+    const auto toBlock { processChain (to) };
+
+    //a linear crossfade over one quantum, which can straddle 2 blocks
+    const auto crossfadeSamplesDone { Constants::processingQuantum - crossfadeSamplesLeft };
+    for (size_t c = 0; c < fromBlock.getNumChannels (); ++c)
+    {
+        auto* fromSamples { fromBlock.getChannelPointer (c) };
+        const auto* toSamples { toBlock.getChannelPointer (c) };
+
+        for (int i = 0; i < curBlockSize; ++i)
+        {
+            const auto gain { T (crossfadeSamplesDone + i + 1) / T (Constants::processingQuantum) };
+            fromSamples[i] += gain * (toSamples[i] - fromSamples[i]);
+        }
+    }
+
+    crossfadeSamplesLeft -= curBlockSize;
+    if (crossfadeSamplesLeft == 0)
+        oscillators.setSampleRate (quantumSpec.sampleRate * to.factor);
+
+    return fromBlock;
 }
 
 template <std::floating_point T>
@@ -332,6 +657,9 @@ void ProPhatVoice<T>::addParamListenersToState ()
     state.addParameterListener (lfoDestID.getParamID (), this);
     state.addParameterListener (lfoFreqID.getParamID (), this);
     state.addParameterListener (lfoAmountID.getParamID (), this);
+
+    state.addParameterListener (oversamplingID.getParamID (), this);
+    state.addParameterListener (filterTypeID.getParamID (), this);
 }
 
 template <std::floating_point T>
@@ -367,8 +695,18 @@ void ProPhatVoice<T>::parameterChanged (const juce::String& parameterID, float n
     else if (parameterID == filterResonanceID.getParamID ())
         setFilterResonance (newValue);
 
+    //picked up by the next control tick, see getTargetOversamplingFactor()
+    else if (parameterID == oversamplingID.getParamID ())
+        oversampling.store ((int) newValue);
+    else if (parameterID == filterTypeID.getParamID ())
+        filterType.store ((int) newValue);
+
     else
         jassertfalse;
+
+    //all of our parameters are part of the control path. This goes last, so the tick that sees the flag also sees
+    //the new value, see isInSteadyState()
+    controlParamChanged.store (true, std::memory_order_release);
 }
 
 template <std::floating_point T>
@@ -532,12 +870,51 @@ void ProPhatVoice<T>::updateLfo()
 }
 
 template <std::floating_point T>
-void ProPhatVoice<T>::startNote (int midiNoteNumber, float velocity, juce::SynthesiserSound* /*sound*/, int currentPitchWheelPosition)
+void ProPhatVoice<T>::updateControllers()
+{
+    if (curChannelControllerState == nullptr)
+        return;
+
+    lastPitchWheelRatio = curChannelControllerState->pitchWheelRatio;
+    oscillators.setPitchWheelRatio (lastPitchWheelRatio);
+
+    //once moved, the tilt range [0-1] is converted to [curFilterCutoff, cutOffRange.end] and added to the cutoff
+    lastModWheel = curChannelControllerState->modWheel;
+    lastModWheelMoved = curChannelControllerState->modWheelMoved;
+    tiltCutoff = lastModWheelMoved ? juce::jmap (T (lastModWheel), curFilterCutoff, T (Constants::cutOffRange.end)) : T (0);
+}
+
+template <std::floating_point T>
+bool ProPhatVoice<T>::isInSteadyState()
+{
+    //always clear the flag, a change forces at least one full control tick
+    if (controlParamChanged.exchange (false, std::memory_order_acquire))
+        return false;
+
+    if (currentlyReleasingNote || currentlyKillingVoice || rampingUp || overlapIndex > -1 || ! isVoiceActive ())
+        return false;
+
+    if (lfoAmount != 0 || oscillators.isGliding () || oscillators.needsFrequencyUpdate () || ampEnvelope != ampParams.sustain || filterEnvelope != filterEnvParams.sustain)
+        return false;
+
+    if (curChannelControllerState != nullptr
+        && (curChannelControllerState->pitchWheelRatio != lastPitchWheelRatio || curChannelControllerState->modWheel != lastModWheel
+            || curChannelControllerState->modWheelMoved != lastModWheelMoved))
+        return false;
+
+    steadyStateGain = static_cast<T> (ampEnvelope);
+    return true;
+}
+
+template <std::floating_point T>
+void ProPhatVoice<T>::startNote (int midiNoteNumber, float velocity, juce::SynthesiserSound* /*sound*/, int /*currentPitchWheelPosition*/)
 {
 #if DEBUG_VOICES
     DBG ("\tDEBUG start: " + juce::String (voiceId));
 #endif
 
+    steadyState = false;
+
     ampADSR.setParameters (ampParams);
     ampADSR.reset();
     ampADSR.noteOn();
@@ -546,7 +923,18 @@ void ProPhatVoice<T>::startNote (int midiNoteNumber, float velocity, juce::Synth
     filterADSR.reset();
     filterADSR.noteOn();
 
-    oscillators.updateOscFrequencies (midiNoteNumber, velocity, currentPitchWheelPosition);
+    //juce::Synthesiser sets the channel before calling startNote, so find which controller state we follow
+    curChannelControllerState = nullptr;
+    for (int channel = 1; channel <= (int) channelControllerStates->size (); ++channel)
+        if (isPlayingChannel (channel))
+            curChannelControllerState = &(*channelControllerStates)[(size_t) channel - 1];
+
+    const auto pitchWheelRatio { curChannelControllerState != nullptr ? curChannelControllerState->pitchWheelRatio : 1.f };
+    oscillators.updateOscFrequencies (midiNoteNumber, velocity, pitchWheelRatio);
+    updateControllers ();
+
+    //a new note doesn't need to crossfade, it ramps up anyway
+    startChain (curFilterCutoff + tiltCutoff);
 
     rampingUp = true;
     rampUpSamplesLeft = Constants::rampUpSamples;
@@ -557,6 +945,8 @@ void ProPhatVoice<T>::startNote (int midiNoteNumber, float velocity, juce::Synth
 template <std::floating_point T>
 void ProPhatVoice<T>::stopNote (float /*velocity*/, bool allowTailOff)
 {
+    steadyState = false;
+
     if (allowTailOff)
     {
         currentlyReleasingNote = true;
@@ -573,10 +963,10 @@ void ProPhatVoice<T>::stopNote (float /*velocity*/, bool allowTailOff)
         {
             rampingUp = false;
 
-            overlap->clear();
+            overlap.clear();
             voicesBeingKilled->insert (voiceId);
             currentlyKillingVoice = true;
-            renderNextBlock (*overlap, 0, Constants::killRampSamples);
+            renderNextBlock (overlap, 0, Constants::killRampSamples);
             overlapIndex = 0;
         }
 
@@ -589,6 +979,40 @@ void ProPhatVoice<T>::stopNote (float /*velocity*/, bool allowTailOff)
     }
 }
 
+template <std::floating_point T>
+void ProPhatVoice<T>::retargetNote (int midiNoteNumber, float velocity, bool retriggerEnvelopes)
+{
+#if DEBUG_VOICES
+    DBG ("\tDEBUG retarget: " + juce::String (voiceId));
+#endif
+
+    steadyState = false;
+
+    //a releasing voice always restarts its envelopes. juce::ADSR::noteOn() attacks from the current level, so unlike
+    //starting a new voice, this needs no kill crossfade or ramp up
+    if (retriggerEnvelopes || currentlyReleasingNote)
+    {
+        currentlyReleasingNote = false;
+
+        ampADSR.noteOn ();
+        filterADSR.noteOn ();
+
+        oscillators.setVelocity (velocity);
+    }
+
+    oscillators.glideTo (midiNoteNumber);
+}
+
+template <std::floating_point T>
+bool ProPhatVoice<T>::isInaudible (const juce::dsp::AudioBlock<T>& block, float ampEnv) const
+{
+    if (ampEnv >= retireThreshold)
+        return false;
+
+    const auto range { block.findMinAndMax () };
+    return juce::jmax (std::abs (range.getStart ()), std::abs (range.getEnd ())) < retireThreshold;
+}
+
 template <std::floating_point T>
 void ProPhatVoice<T>::processRampUp (juce::dsp::AudioBlock<T>& block, int curBlockSize)
 {
@@ -637,7 +1061,7 @@ void ProPhatVoice<T>::processKillOverlap (juce::dsp::AudioBlock<T>& block, int c
         for (int i = 0; i < curSamples; ++i)
         {
             auto prev = block.getSample (c, i);
-            auto overl = static_cast<T> (overlap->getSample (c, overlapIndex + i));
+            auto overl = static_cast<T> (overlap.getSample (c, overlapIndex + i));
             auto total = prev + overl;
 
             jassert (total > -1 && total < 1);
@@ -0,0 +1,207 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "PolyBlep.h"
+
+/**
+ * @brief Renders up to Constants::maxUnisonVoices detuned copies of an oscillator shape, spread across the stereo field.
+    All copies always advance together: each of them is a lane in fixed-size arrays, so the inner loop has a constant
+    trip count and the compiler can keep the phases in SIMD registers. Unused lanes simply have a gain of 0.
+    The shapes are computed from the phase with PolyBlep instead of read from a table, for the same reason.
+    The phases are 32-bit fixed point, which wrap around on their own and stay exact over long notes, even in the float engine.
+*/
+template <std::floating_point T>
+class UnisonOscillator
+{
+public:
+    static constexpr size_t maxVoices { Constants::maxUnisonVoices };
+
+    UnisonOscillator ()
+    {
+        //random starting phases, so the copies don't start in phase. Evenly spaced phases would be worse, since
+        //they cancel each other's lower harmonics until the detuning drifts them apart
+        juce::Random rng;
+        for (auto& phase : phases)
+            phase = static_cast<uint32_t> (rng.nextInt ());
+    }
+
+    void prepare (double newSampleRate) { sampleRate = newSampleRate; }
+
+    void setNumVoices (int newNumVoices)
+    {
+        jassert (Helpers::valueContainedInRange (newNumVoices, Constants::unisonVoicesRange));
+        numVoices = newNumVoices;
+        lanesChanged = true;
+    }
+
+    void setDetune (float newDetune)
+    {
+        jassert (Helpers::valueContainedInRange (newDetune, Constants::sliderRange));
+        detune = newDetune;
+        lanesChanged = true;
+    }
+
+    void setSpread (float newSpread)
+    {
+        jassert (Helpers::valueContainedInRange (newSpread, Constants::sliderRange));
+        spread = newSpread;
+        lanesChanged = true;
+    }
+
+    int getNumVoices () const { return numVoices.load (); }
+
+    /** Adds all the copies to the first 2 channels of block, or their mono sum if block only has one, scaled by gain.
+    *   The center of the stack moves linearly from startFrequency to endFrequency over the block, reaching it on the
+    *   last sample, like ProPhatOscillator's frequency ramp.
+    */
+    void process (const juce::dsp::AudioBlock<T>& block, OscShape::Values shape, T startFrequency, T endFrequency, T gain = T (1));
+
+private:
+    void updateLanes ();
+
+    template <OscShape::Values shape>
+    void processShape (const juce::dsp::AudioBlock<T>& block, T startFrequency, T endFrequency, T gain);
+
+    /** Converts a phase in cycles to fixed point, wrapping it into [0, 1) first: a copy above the sample rate
+    *   aliases, but its increment still has to fit in 32 bits.
+    */
+    static uint32_t toFixedPoint (double cycles) { return static_cast<uint32_t> ((cycles - std::floor (cycles)) * phaseRange); }
+
+    //a full cycle is 2^32
+    static constexpr auto phaseRange { 4294967296. };
+
+    alignas (64) std::array<uint32_t, maxVoices> phases {};
+    alignas (64) std::array<T, maxVoices> ratios {};
+    alignas (64) std::array<T, maxVoices> leftGains {};
+    alignas (64) std::array<T, maxVoices> rightGains {};
+
+    std::atomic<int> numVoices { Constants::defaultUnisonVoices };
+    std::atomic<float> detune { Constants::defaultUnisonDetune }, spread { Constants::defaultUnisonSpread };
+    std::atomic<bool> lanesChanged { true };
+
+    double sampleRate { 44100. };
+};
+
+//====================================================================================================
+
+template <std::floating_point T>
+void UnisonOscillator<T>::updateLanes ()
+{
+    const auto curNumVoices { (size_t) numVoices.load () };
+    const auto maxDetune { detune.load () * Constants::maxUnisonDetuneSemitones };
+    const auto curSpread { spread.load () };
+
+    //keep the stack at about the same loudness whatever its size
+    const auto laneGain { T (1) / std::sqrt (T (curNumVoices)) };
+
+    for (size_t v = 0; v < maxVoices; ++v)
+    {
+        if (v >= curNumVoices)
+        {
+            ratios[v] = 1;
+            leftGains[v] = rightGains[v] = 0;
+            continue;
+        }
+
+        //position of this copy in the stack, in [-1, 1]
+        const auto position { curNumVoices > 1 ? 2 * (T) v / T (curNumVoices - 1) - 1 : T (0) };
+        ratios[v] = std::exp2 (position * maxDetune / 12);
+
+        //equal power panning, normalised so a centered copy has a gain of 1 on both sides
+        const auto angle { (1 + position * curSpread) * juce::MathConstants<T>::pi / 4 };
+        leftGains[v] = laneGain * juce::MathConstants<T>::sqrt2 * std::cos (angle);
+        rightGains[v] = laneGain * juce::MathConstants<T>::sqrt2 * std::sin (angle);
+    }
+}
+
+template <std::floating_point T>
+void UnisonOscillator<T>::process (const juce::dsp::AudioBlock<T>& block, OscShape::Values shape, T startFrequency, T endFrequency, T gain)
+{
+    if (lanesChanged.exchange (false))
+        updateLanes ();
+
+    switch (shape)
+    {
+        case OscShape::saw:         processShape<OscShape::saw> (block, startFrequency, endFrequency, gain); break;
+        case OscShape::sawTri:      processShape<OscShape::sawTri> (block, startFrequency, endFrequency, gain); break;
+        case OscShape::triangle:    processShape<OscShape::triangle> (block, startFrequency, endFrequency, gain); break;
+        case OscShape::pulse:       processShape<OscShape::pulse> (block, startFrequency, endFrequency, gain); break;
+        default:                    break;
+    }
+}
+
+template <std::floating_point T>
+template <OscShape::Values shape>
+void UnisonOscillator<T>::processShape (const juce::dsp::AudioBlock<T>& block, T startFrequency, T endFrequency, T gain)
+{
+    jassert (block.getNumChannels () <= 2);
+
+    //the increments in fixed point to advance the phases, and in cycles for the band-limiting, with how much they
+    //change every sample. The fixed point ones wrap around like the phases, so their steps can too
+    alignas (64) std::array<uint32_t, maxVoices> increments, incrementSteps;
+    alignas (64) std::array<T, maxVoices> phaseIncrements, phaseIncrementSteps, laneLeftGains, laneRightGains;
+    const auto numSamples { block.getNumSamples () };
+    for (size_t v = 0; v < maxVoices; ++v)
+    {
+        const auto startIncrement { startFrequency * ratios[v] / sampleRate };
+        const auto incrementStep { (endFrequency - startFrequency) * ratios[v] / sampleRate / (double) juce::jmax ((size_t) 1, numSamples) };
+
+        increments[v] = toFixedPoint (startIncrement);
+        incrementSteps[v] = toFixedPoint (incrementStep);
+        phaseIncrements[v] = static_cast<T> (startIncrement);
+        phaseIncrementSteps[v] = static_cast<T> (incrementStep);
+        laneLeftGains[v] = leftGains[v] * gain;
+        laneRightGains[v] = rightGains[v] * gain;
+    }
+
+    auto* left { block.getChannelPointer (0) };
+    auto* right { block.getNumChannels () > 1 ? block.getChannelPointer (1) : nullptr };
+
+    for (size_t i = 0; i < block.getNumSamples (); ++i)
+    {
+        T leftSample { 0 }, rightSample { 0 };
+
+        for (size_t v = 0; v < maxVoices; ++v)
+        {
+            increments[v] += incrementSteps[v];
+            phaseIncrements[v] += phaseIncrementSteps[v];
+            phases[v] += increments[v];
+
+            //the top 24 bits convert exactly to a float in [0, 1)
+            const auto phase { static_cast<T> (static_cast<int32_t> (phases[v] >> 8)) * T (1. / (1 << 24)) };
+            const auto sample { PolyBlep::getSample<shape> (phase, phaseIncrements[v]) };
+            leftSample += sample * laneLeftGains[v];
+            rightSample += sample * laneRightGains[v];
+        }
+
+        if (right != nullptr)
+        {
+            left[i] += leftSample;
+            right[i] += rightSample;
+        }
+        else
+        {
+            left[i] += (leftSample + rightSample) / 2;
+        }
+    }
+}
@@ -217,6 +217,9 @@ void ProPhatEditor::buttonClicked (juce::Button*)
     m.addItem (3, juce::translate ("Load a saved state..."));
     m.addSeparator ();
     m.addItem (4, juce::translate ("Reset to default state"));
+    m.addSeparator ();
+    m.addItem (5, juce::translate ("Load a Scala tuning..."));
+    m.addItem (6, juce::translate ("Reset tuning to 12-TET"));
 
     m.showMenuAsync (juce::PopupMenu::Options (),
                      juce::ModalCallbackFunction::forComponent (menuCallback, this));
@@ -234,6 +237,8 @@ void ProPhatEditor::handleMenuResult (int result)
                 case 2:  pluginHolder->askUserToSaveState (); break;
                 case 3:  pluginHolder->askUserToLoadState (); break;
                 case 4:  app->resetToDefaultState (); break;
+                case 5:  askUserToLoadTuning (); break;
+                case 6:  processor.resetTuning (); break;
                 default: jassertfalse; break;
             }
             return;
@@ -241,6 +246,31 @@ void ProPhatEditor::handleMenuResult (int result)
     }
     jassertfalse;
 }
+
+void ProPhatEditor::askUserToLoadTuning ()
+{
+    tuningChooser = std::make_unique<juce::FileChooser> (juce::translate ("Select a .scl file, and optionally a .kbm file"),
+                                                         juce::File (), "*.scl;*.kbm");
+
+    const auto flags { juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles
+                       | juce::FileBrowserComponent::canSelectMultipleItems };
+
+    tuningChooser->launchAsync (flags, [this] (const juce::FileChooser& chooser)
+    {
+        juce::File scl, kbm;
+        for (const auto& file : chooser.getResults ())
+            (file.hasFileExtension (".kbm") ? kbm : scl) = file;
+
+        if (scl == juce::File ())
+            return;
+
+        const auto result { processor.loadTuning (scl.loadFileAsString (), kbm.existsAsFile () ? kbm.loadFileAsString () : juce::String ()) };
+
+        if (result.failed ())
+            juce::AlertWindow::showMessageBoxAsync (juce::MessageBoxIconType::WarningIcon, juce::translate ("Can't load this tuning"),
+                                                    result.getErrorMessage ());
+    });
+}
 #endif
 
 void ProPhatEditor::paint (juce::Graphics& g)
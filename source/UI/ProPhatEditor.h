@@ -78,6 +78,11 @@ private:
     }
 
     void handleMenuResult (int result);
+
+    /** Lets the user pick a .scl file, and optionally a .kbm file along with it, and loads them in the processor. */
+    void askUserToLoadTuning ();
+
+    std::unique_ptr<juce::FileChooser> tuningChooser;
 #endif
 
     juce::GroupComponent oscGroup, filterGroup, ampGroup, lfoGroup, effectGroup;
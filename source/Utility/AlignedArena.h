@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "juce_core/juce_core.h"
+#include <new>
+
+/** One contiguous, cache-line-aligned block of memory, handed out in aligned chunks by bumping a pointer.
+*   We use it to keep the voices and their scratch buffers next to each other, in the order they are rendered.
+*   Allocating is not thread safe and should only happen when preparing, never on the audio thread.
+*/
+class AlignedArena
+{
+public:
+    static constexpr size_t alignment { 64 };
+
+    static constexpr size_t alignUp (size_t numBytes) { return (numBytes + alignment - 1) & ~(alignment - 1); }
+
+    /** The number of bytes allocate<Type> (count) will take out of the arena. */
+    template <typename Type>
+    static constexpr size_t getAllocationSize (size_t count) { return alignUp (sizeof (Type) * count); }
+
+    AlignedArena () = default;
+    ~AlignedArena () { release (); }
+
+    /** Releases whatever was allocated, and reserves numBytes of zeroed memory. */
+    void reset (size_t numBytes)
+    {
+        release ();
+
+        size = alignUp (numBytes);
+        used = 0;
+
+        if (size > 0)
+        {
+            data = static_cast<char*> (::operator new (size, std::align_val_t { alignment }));
+            std::memset (data, 0, size);
+        }
+    }
+
+    /** Returns uninitialised, aligned storage for count objects of Type. */
+    template <typename Type>
+    Type* allocate (size_t count)
+    {
+        static_assert (alignof (Type) <= alignment);
+
+        const auto numBytes { getAllocationSize<Type> (count) };
+        jassert (used + numBytes <= size); //the arena was sized too small!
+
+        auto* chunk { data + used };
+        used += numBytes;
+        return reinterpret_cast<Type*> (chunk);
+    }
+
+    size_t getSize () const { return size; }
+    size_t getNumBytesUsed () const { return used; }
+
+private:
+    void release ()
+    {
+        if (data != nullptr)
+            ::operator delete (data, std::align_val_t { alignment });
+
+        data = nullptr;
+        size = used = 0;
+    }
+
+    char* data = nullptr;
+    size_t size = 0, used = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (AlignedArena)
+};
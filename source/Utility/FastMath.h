@@ -0,0 +1,136 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "Macros.h"
+#include "juce_core/juce_core.h"
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+
+/** Approximations of the functions in the hot paths of the voice and its filter. None of them branch or read
+    a table, so they vectorise. Other than tanh, they're about as precise as a float gets, in doubles too, and the
+    error bounds below are checked in tests/FastMath.cpp. Call them through the FastMath functions, which go to the
+    std ones instead when USE_FAST_MATH is 0.
+*/
+namespace FastMath::Approximations
+{
+/** sin (x), within 3e-7 of std::sin for floats in [-10, 10], and within 6e-8 for any double. Floats further out lose
+*   a bit more in the reduction to [-pi, pi], as much as the precision of x itself.
+*/
+template <std::floating_point T>
+inline T sin (T x) noexcept
+{
+    //to [-pi, pi], then [-pi/2, pi/2] through sin (pi - x) = sin (x), where an odd polynomial takes it
+    constexpr auto pi { T (3.14159265358979323846) }, twoPi { 2 * pi }, halfPi { pi / 2 };
+    x -= twoPi * std::floor (x / twoPi + T (.5));
+
+    const auto magnitude { halfPi - std::abs (halfPi - std::abs (x)) };
+    const auto x2 { magnitude * magnitude };
+    const auto y { magnitude * (T (1) + x2 * (T (-1. / 6) + x2 * (T (1. / 120) + x2 * (T (-1. / 5040) + x2 * (T (1. / 362880) + x2 * T (-1. / 39916800)))))) };
+
+    return std::copysign (y, x);
+}
+
+/** tanh (x) for x clamped to [-5, 5], like the lookup table in juce::dsp::LadderFilter, through the same rational
+*   approximation as juce::dsp::FastMathApproximations::tanh(). It's within 1.1e-4 of std::tanh for any x.
+*/
+template <std::floating_point T>
+inline T tanh (T x) noexcept
+{
+    //std::clamp() would be a branch the compiler can't turn into a select without -fno-trapping-math
+    x = T (.5) * (std::abs (x + T (5)) - std::abs (x - T (5)));
+
+    const auto x2 { x * x };
+    const auto numerator { x * (T (135135) + x2 * (T (17325) + x2 * (T (378) + x2))) };
+    const auto denominator { T (135135) + x2 * (T (62370) + x2 * (T (3150) + T (28) * x2)) };
+    return numerator / denominator;
+}
+
+/** 2^x without std::pow. The fractional part goes through a degree 5 polynomial, fitted for relative error, which
+*   is within 8e-8 (about 1e-4 cent) of the real thing, and 2e-7 once rounded to a float. x needs to be in [-126, 128).
+*/
+template <std::floating_point T>
+inline T exp2 (T x) noexcept
+{
+    jassert (x >= T (-126) && x < T (128));
+
+    const auto integer { std::floor (x) };
+    const auto f { x - integer };
+
+    const auto fraction { T (0.9999999269) + f * (T (0.6931529682) + f * (T (0.2401545299) + f * (T (0.05582360446) + f * (T (0.008992584031) + f * T (0.001876232945))))) };
+
+    //2^integer, straight into the exponent bits
+    if constexpr (std::same_as<T, float>)
+        return fraction * std::bit_cast<float> (static_cast<uint32_t> (static_cast<int32_t> (integer) + 127) << 23);
+    else
+        return fraction * T (std::bit_cast<double> (static_cast<uint64_t> (static_cast<int64_t> (integer) + 1023) << 52));
+}
+
+/** log2 (x) for a normal, positive x. That's within 2e-7 of std::log2 for floats and 2e-9 for doubles, relative to
+*   the result past [-1, 1].
+*/
+template <std::floating_point T>
+inline T log2 (T x) noexcept
+{
+    jassert (x >= std::numeric_limits<T>::min ());
+
+    //split x into 2^exponent * mantissa, with the mantissa in [sqrt (.5), sqrt (2)) so log2 (mantissa) stays small
+    T exponent, mantissa;
+    if constexpr (std::same_as<T, float>)
+    {
+        const auto bits { std::bit_cast<uint32_t> (x) - 0x3f3504f3u };
+        exponent = T (static_cast<int32_t> (bits) >> 23);
+        mantissa = std::bit_cast<float> ((bits & 0x007fffffu) + 0x3f3504f3u);
+    }
+    else
+    {
+        const auto bits { std::bit_cast<uint64_t> (static_cast<double> (x)) - 0x3fe6a09e667f3bcdull };
+        exponent = T (static_cast<int64_t> (bits) >> 52);
+        mantissa = T (std::bit_cast<double> ((bits & 0x000fffffffffffffull) + 0x3fe6a09e667f3bcdull));
+    }
+
+    //log (m) = 2 atanh ((m - 1) / (m + 1)), and that's within [-.172, .172] where atanh's series converges fast
+    const auto t { (mantissa - 1) / (mantissa + 1) };
+    const auto t2 { t * t };
+    const auto log { 2 * t * (T (1) + t2 * (T (1. / 3) + t2 * (T (1. / 5) + t2 * (T (1. / 7) + t2 * T (1. / 9))))) };
+
+    return exponent + log * T (1.44269504088896340736);
+}
+}
+
+namespace FastMath
+{
+#if USE_FAST_MATH
+using Approximations::sin;
+using Approximations::tanh;
+using Approximations::exp2;
+using Approximations::log2;
+#else
+template <std::floating_point T> inline T sin (T x) noexcept { return std::sin (x); }
+template <std::floating_point T> inline T tanh (T x) noexcept { return std::tanh (x); }
+template <std::floating_point T> inline T exp2 (T x) noexcept { return std::exp2 (x); }
+template <std::floating_point T> inline T log2 (T x) noexcept { return std::log2 (x); }
+#endif
+}
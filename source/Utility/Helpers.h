@@ -50,11 +50,20 @@ constexpr auto middleCMidiNote          { 60 }; //C3 on rev2
 constexpr auto killRampSamples          { 300 };
 constexpr auto rampUpSamples            { 100 };
 
+//note-ons that arrive while all voices are being killed wait in a backlog, for at most this long
+constexpr auto maxPendingNoteOns        { 32 };
+constexpr auto maxNoteOnLatencySeconds  { .01 };
+
+//voices always render in chunks of this many samples, whatever the host block size is. Control-rate
+//updates (lfo, filter envelope) happen once per quantum
+constexpr auto processingQuantum        { 64 };
+
 constexpr auto defaultOscLevel          { .4f };
 constexpr auto defaultMasterGain        { .8f };
 
 constexpr auto defaultFilterCutoff      { 1000.f };
 constexpr auto defaultFilterResonance   { .5f };
+constexpr auto defaultFilterType        { 0 };
 
 constexpr float defaultLfoFreq          { 3.f };
 constexpr float defaultLfoAmount        { 0.f };
@@ -70,6 +79,32 @@ constexpr auto defaultAmpD              { minAmp };
 constexpr auto defaultAmpS              { 1.f };
 constexpr auto defaultAmpR              { .25f };
 
+//releasing voices are retired once both their amp envelope and output are below this
+constexpr auto defaultVoiceRetireThresholdDb { -100.f };
+
+//mono and legato voice modes
+constexpr auto defaultVoiceMode         { 0 };
+constexpr auto defaultGlideTime         { 0.f };
+constexpr auto maxMonoHeldNotes         { 16 };
+
+//the oscillators and the filter can run at 2 or 4 times the sample rate, see ProPhatVoice::startChain()
+constexpr auto defaultOversampling      { 0 };
+constexpr auto maxOversamplingFactor    { 4 };
+
+//in auto, voices are oversampled when their 8th harmonic, or their cutoff if it's lower, goes over these fractions of
+//the sample rate, eg over 6 kHz and 12 kHz at 48 kHz
+constexpr auto adaptiveOversamplingHarmonics    { 8.f };
+constexpr auto adaptiveOversampling2xThreshold  { 1.f / 8 };
+constexpr auto adaptiveOversampling4xThreshold  { 1.f / 4 };
+constexpr auto adaptiveOversamplingHysteresis   { .8f };
+
+//unison stacks up to maxUnisonVoices copies of osc1 and osc2, detuned by up to maxUnisonDetuneSemitones
+constexpr size_t maxUnisonVoices        { 8 };
+constexpr auto defaultUnisonVoices      { 1 };
+constexpr auto defaultUnisonDetune      { .2f };
+constexpr auto defaultUnisonSpread      { .5f };
+constexpr auto maxUnisonDetuneSemitones { .5f };
+
 constexpr auto sustainSkewFactor        { .5f };
 constexpr auto ampSkewFactor            { .5f };
 constexpr auto cutOffSkewFactor         { .5f };
@@ -88,9 +123,11 @@ const juce::NormalisableRange<float> slopSliderRange    { 0.f, 1.0f, 0.f, slopSk
 const juce::NormalisableRange<float> cutOffRange        { 0.1f, 18000.f, 0.f, cutOffSkewFactor };
 const juce::NormalisableRange<float> lfoRange           { 0.1f, 10.f };
 const juce::NormalisableRange<float> lfoNoteRange       { 0.f, 16.f };
+const juce::NormalisableRange<float> glideRange         { 0.f, 5.f, 0.f, .5f };
 
 //Sets the base frequency of Oscillator 1 or 2 over a 9-octave
 //range from 16 Hz to 8KHz (when used with the Transpose buttons). Adjustment is in semitones.
+const juce::NormalisableRange<int> unisonVoicesRange    { 1, (int) maxUnisonVoices };
 const juce::NormalisableRange<int> midiNoteRange        { 12, 120 };   //actual midi note range is (0,127), but rev2, at least for oscilators is C0(0) to C10(120)
 const juce::NormalisableRange<float> pitchWheelNoteRange{ -7.f, 7.f };
 }
@@ -114,6 +151,7 @@ const juce::ParameterID oscSlopID          { "Osc Slop", 1 };
 
 const juce::ParameterID filterCutoffID     { "Filter Cutoff", 1 };
 const juce::ParameterID filterResonanceID  { "Filter Reso", 1 };
+const juce::ParameterID filterTypeID       { "Filter Type", 1 };
 
 const juce::ParameterID ampAttackID        { "Amp Attack", 1 };
 const juce::ParameterID ampDecayID         { "Amp Decay", 1 };
@@ -134,6 +172,15 @@ const juce::ParameterID effectParam1ID     { "Effect Param1", 1 };
 const juce::ParameterID effectParam2ID     { "Effect Param2", 1 };
 
 const juce::ParameterID masterGainID       { "Master Gain", 1 };
+
+const juce::ParameterID voiceModeID        { "Voice Mode", 1 };
+const juce::ParameterID glideID            { "Glide", 1 };
+
+const juce::ParameterID oversamplingID     { "Oversampling", 1 };
+
+const juce::ParameterID unisonVoicesID     { "Unison Voices", 1 };
+const juce::ParameterID unisonDetuneID     { "Unison Detune", 1 };
+const juce::ParameterID unisonSpreadID     { "Unison Spread", 1 };
 }
 
 //====================================================================================================
@@ -202,6 +249,20 @@ constexpr auto lfoDest0     { "Osc1 Freq" };
 constexpr auto lfoDest1     { "Osc2 Freq" };
 constexpr auto lfoDest2     { "Cutoff" };
 constexpr auto lfoDest3     { "Resonance" };
+
+constexpr auto voiceMode0   { "Poly" };
+constexpr auto voiceMode1   { "Mono" };
+constexpr auto voiceMode2   { "Legato" };
+
+constexpr auto oversampling0    { "1x" };
+constexpr auto oversampling1    { "2x" };
+constexpr auto oversampling2    { "4x" };
+constexpr auto oversampling3    { "Auto" };
+
+constexpr auto filterType0      { "Ladder 12 dB" };
+constexpr auto filterType1      { "Ladder 24 dB" };
+constexpr auto filterType2      { "State Variable" };
+constexpr auto filterType3      { "One Pole" };
 }
 
 struct Selection
@@ -264,6 +325,51 @@ struct LfoDest : public Selection
     bool isNullSelectionAllowed () override { return false; }
 };
 
+struct VoiceMode : public Selection
+{
+    enum
+    {
+        poly = 0,
+        mono,   //one voice, retriggering its envelopes on every note
+        legato, //one voice, only retriggering its envelopes when no other key is held
+        totalSelectable
+    };
+
+    int getLastSelectionIndex () override { return totalSelectable - 1; }
+    bool isNullSelectionAllowed () override { return false; }
+};
+
+struct Oversampling : public Selection
+{
+    enum
+    {
+        x1 = 0,
+        x2,
+        x4,
+        automatic,  //per voice, depending on its note and cutoff
+        totalSelectable
+    };
+
+    int getLastSelectionIndex () override { return totalSelectable - 1; }
+    bool isNullSelectionAllowed () override { return false; }
+};
+
+/** The filter topologies, see FilterTopology. */
+struct FilterType : public Selection
+{
+    enum
+    {
+        ladder2Pole = 0,
+        ladder4Pole,
+        stateVariable,
+        onePole,
+        totalSelectable
+    };
+
+    int getLastSelectionIndex () override { return totalSelectable - 1; }
+    bool isNullSelectionAllowed () override { return false; }
+};
+
 //====================================================================================================
 
 /** This struct can be used to have a single shared font object throughout the plugin. To use it somewhere,
@@ -300,12 +406,6 @@ inline float getRangedParamValue (juce::AudioProcessorValueTreeState& state, juc
     return param == nullptr ? 0.f : param->convertFrom0to1 (param->getValue());
 }
 
-template <std::floating_point T>
-T getMidiNoteInHertz (const T noteNumber, const T frequencyOfA = 440) noexcept
-{
-    return static_cast<T> (frequencyOfA * std::pow (2, (noteNumber - 69) / 12));
-}
-
 template <typename Type>
 inline bool valueContainedInRange (Type value, juce::NormalisableRange<Type> range)
 {
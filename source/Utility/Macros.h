@@ -38,6 +38,26 @@
  #define USE_NATIVE_TITLE_BAR 1
 #endif
 
+//set to 1 to serve double precision hosts with the float engine by default, see ProPhatProcessor::setDoubleHostEngine()
+#ifndef RENDER_DOUBLE_HOSTS_IN_FLOAT
+ #define RENDER_DOUBLE_HOSTS_IN_FLOAT 0
+#endif
+
+//the main oscillators read the shared mipmapped wavetables, set to 0 to compute them with PolyBLEP instead
+#ifndef USE_WAVETABLE_OSCILLATORS
+ #define USE_WAVETABLE_OSCILLATORS 1
+#endif
+
+//noise oscillators run their own generators, set to 1 to have them all read one shared stream instead, see BlockNoise
+#ifndef SHARE_NOISE_STREAM
+ #define SHARE_NOISE_STREAM 0
+#endif
+
+//the voice, its lfo and its filter go through the approximations in FastMath, set to 0 to use the std functions instead
+#ifndef USE_FAST_MATH
+ #define USE_FAST_MATH 1
+#endif
+
 #ifndef USE_BACKGROUND_IMAGE
  #define USE_BACKGROUND_IMAGE 0
 #endif
@@ -0,0 +1,270 @@
+/*
+  ==============================================================================
+
+    ProPhat is a virtual synthesizer inspired by the Prophet REV2.
+    Copyright (C) 2024 Vincent Berthiaume
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "FastMath.h"
+#include "Helpers.h"
+
+/**
+ * @brief The pitch of every midi note, in 12-TET by default, or loaded from Scala files (.scl and .kbm).
+    Pitches are kept as log2 of the frequency, so a fractional note from a glide interpolates linearly between its
+    2 neighbours, and offsets in semitones can be added to a pitch before it goes through FastMath::exp2().
+
+    Loading parses the files on the message thread, into a pending table. The audio thread picks that up in update(),
+    with a try lock, so it never waits, and copying a fixed-size array never allocates.
+*/
+class TuningTable
+{
+public:
+    static constexpr int numNotes { 128 };
+
+    using Pitches = std::array<float, numNotes>;
+
+    static constexpr Pitches getEqualTemperament ()
+    {
+        //log2 (440)
+        constexpr auto log2OfA { 8.781359713524660 };
+
+        Pitches pitches {};
+        for (int n = 0; n < numNotes; ++n)
+            pitches[(size_t) n] = static_cast<float> (log2OfA + (n - 69) / 12.);
+
+        return pitches;
+    }
+
+    TuningTable () = default;
+
+    /** log2 of the frequency of a fractional midi note. Notes outside of [0, 127] play the closest end of the table. */
+    float getPitch (float note) const noexcept
+    {
+        note = juce::jlimit (0.f, static_cast<float> (numNotes - 1), note);
+
+        const auto index { juce::jmin (numNotes - 2, static_cast<int> (note)) };
+        const auto fraction { note - static_cast<float> (index) };
+
+        const auto low { active[(size_t) index] };
+        return low + fraction * (active[(size_t) index + 1] - low);
+    }
+
+    /** The frequency of a fractional midi note, see getPitch(). */
+    float getFrequency (float note) const noexcept { return FastMath::exp2 (getPitch (note)); }
+
+    /** Loads a Scala scale, and an optional keyboard mapping, from their file contents. On failure the current
+    *   tuning is kept. Call this on the message thread, the audio thread only sees it after its next update().
+    */
+    juce::Result loadScala (const juce::String& scl, const juce::String& kbm = {});
+
+    void resetToEqualTemperament () { setPending (getEqualTemperament ()); }
+
+    /** Applies the tuning loaded last, if any. Called on the audio thread at the start of each block, this returns
+    *   true when the pitches changed, so playing notes can be retuned.
+    */
+    bool update () noexcept
+    {
+        if (! hasPending.load ())
+            return false;
+
+        const juce::SpinLock::ScopedTryLockType lock (pendingLock);
+        if (! lock.isLocked ())
+            return false;
+
+        active = pending;
+        hasPending.store (false);
+        return true;
+    }
+
+private:
+    void setPending (const Pitches& newPitches)
+    {
+        const juce::SpinLock::ScopedLockType lock (pendingLock);
+        pending = newPitches;
+        hasPending.store (true);
+    }
+
+    Pitches active { getEqualTemperament () }, pending { active };
+    juce::SpinLock pendingLock;
+    std::atomic<bool> hasPending { false };
+
+    JUCE_DECLARE_NON_COPYABLE (TuningTable)
+};
+
+//====================================================================================================
+
+namespace ScalaParsing
+{
+/** The lines of a Scala file that aren't comments, each trimmed down to its first token. */
+inline juce::StringArray getValueLines (const juce::String& text)
+{
+    juce::StringArray values;
+
+    for (const auto& line : juce::StringArray::fromLines (text))
+        if (! line.startsWithChar ('!'))
+            values.add (line.trim ().initialSectionNotContaining (" \t"));
+
+    return values;
+}
+
+inline bool isInteger (const juce::String& s)
+{
+    const auto digits { s.startsWithChar ('-') ? s.substring (1) : s };
+    return digits.isNotEmpty () && digits.containsOnly ("0123456789");
+}
+
+/** A pitch line of a .scl file: cents if it has a period, otherwise a ratio like 3/2 or 2. */
+inline std::optional<double> parseCents (const juce::String& value)
+{
+    if (value.containsChar ('.'))
+    {
+        //a single period, with digits around it
+        if (! isInteger (value.upToFirstOccurrenceOf (".", false, false) + value.fromFirstOccurrenceOf (".", false, false)))
+            return {};
+
+        return value.getDoubleValue ();
+    }
+
+    const auto numerator { value.upToFirstOccurrenceOf ("/", false, false) };
+    const auto denominator { value.containsChar ('/') ? value.fromFirstOccurrenceOf ("/", false, false) : juce::String ("1") };
+
+    if (! isInteger (numerator) || ! isInteger (denominator))
+        return {};
+
+    const auto ratio { numerator.getDoubleValue () / denominator.getDoubleValue () };
+    if (! (ratio > 0.) || ! std::isfinite (ratio))
+        return {};
+
+    return 1200. * std::log2 (ratio);
+}
+
+inline int floorDivide (int a, int b) { return (int) std::floor ((double) a / (double) b); }
+inline int positiveModulo (int a, int b) { return ((a % b) + b) % b; }
+}
+
+inline juce::Result TuningTable::loadScala (const juce::String& scl, const juce::String& kbm)
+{
+    using namespace ScalaParsing;
+
+    //the scale: a description, the number of notes, then each note in cents or as a ratio, the last one being the period
+    const auto sclLines { getValueLines (scl) };
+    if (sclLines.size () < 2 || ! isInteger (sclLines[1]))
+        return juce::Result::fail ("The scale doesn't have a number of notes");
+
+    const auto scaleSize { sclLines[1].getIntValue () };
+    if (scaleSize < 1 || sclLines.size () < 2 + scaleSize)
+        return juce::Result::fail ("The scale doesn't have as many notes as it says");
+
+    std::vector<double> scaleCents;
+    for (int i = 0; i < scaleSize; ++i)
+    {
+        const auto cents { parseCents (sclLines[2 + i]) };
+        if (! cents.has_value ())
+            return juce::Result::fail ("Can't read scale note " + juce::String (i + 1) + ": " + sclLines[2 + i]);
+
+        scaleCents.push_back (*cents);
+    }
+
+    //the mapping. Without a .kbm, every key goes to the next scale degree, and middle C plays the first degree at its 12-TET pitch
+    auto mapSize { 0 }, middleNote { 60 }, referenceNote { 60 }, formalOctave { scaleSize };
+    auto referenceFrequency { 261.6255653005986 };
+    std::vector<int> mapping;
+
+    if (kbm.trim ().isNotEmpty ())
+    {
+        auto kbmLines { getValueLines (kbm) };
+        kbmLines.removeEmptyStrings ();
+
+        if (kbmLines.size () < 7)
+            return juce::Result::fail ("The keyboard mapping is missing some of its header");
+
+        //the header is the map size, the first and last keys to retune (which we ignore, all keys are retuned),
+        //the key of the first degree, the reference key, its frequency, and the degree of the formal octave
+        mapSize = kbmLines[0].getIntValue ();
+        middleNote = kbmLines[3].getIntValue ();
+        referenceNote = kbmLines[4].getIntValue ();
+        referenceFrequency = kbmLines[5].getDoubleValue ();
+        formalOctave = kbmLines[6].getIntValue ();
+
+        if (mapSize < 0 || ! (referenceFrequency > 0.) || formalOctave < 0)
+            return juce::Result::fail ("The keyboard mapping header is invalid");
+
+        //a formal octave of 0 means the whole scale
+        if (formalOctave == 0)
+            formalOctave = scaleSize;
+
+        for (int i = 0; i < mapSize; ++i)
+        {
+            //keys missing at the end of the mapping, or marked with an x, are unmapped
+            const auto value { 7 + i < kbmLines.size () ? kbmLines[7 + i] : juce::String ("x") };
+            mapping.push_back (isInteger (value) ? value.getIntValue () : -1);
+        }
+    }
+
+    const auto period { scaleCents.back () };
+
+    //the cents of a key, relative to the first degree on middleNote, or nothing for unmapped keys
+    const auto getKeyCents = [&] (int key) -> std::optional<double>
+    {
+        auto degree { key - middleNote };
+
+        if (mapSize > 0)
+        {
+            const auto mapped { mapping[(size_t) positiveModulo (degree, mapSize)] };
+            if (mapped < 0)
+                return {};
+
+            degree = floorDivide (degree, mapSize) * formalOctave + mapped;
+        }
+
+        const auto step { positiveModulo (degree, scaleSize) };
+        return floorDivide (degree, scaleSize) * period + (step == 0 ? 0. : scaleCents[(size_t) step - 1]);
+    };
+
+    const auto referenceCents { getKeyCents (referenceNote) };
+    if (! referenceCents.has_value ())
+        return juce::Result::fail ("The reference key isn't mapped");
+
+    //we can't leave keys silent like Scala does, so unmapped keys play the pitch of the closest mapped key below them
+    Pitches pitches {};
+    std::optional<float> lastPitch;
+
+    for (int n = 0; n < numNotes; ++n)
+    {
+        if (const auto cents { getKeyCents (n) })
+            lastPitch = static_cast<float> (std::log2 (referenceFrequency) + (*cents - *referenceCents) / 1200.);
+
+        pitches[(size_t) n] = lastPitch.value_or (std::numeric_limits<float>::quiet_NaN ());
+    }
+
+    //and keys below the first mapped one play that one
+    const auto firstMapped { std::find_if (pitches.begin (), pitches.end (), [] (float p) { return ! std::isnan (p); }) };
+    if (firstMapped == pitches.end ())
+        return juce::Result::fail ("The keyboard mapping doesn't map any key");
+
+    std::fill (pitches.begin (), firstMapped, *firstMapped);
+
+    //FastMath::exp2() only covers so much
+    for (const auto pitch : pitches)
+        if (pitch < -100.f || pitch > 100.f)
+            return juce::Result::fail ("The tuning goes way out of the audible range");
+
+    setPending (pitches);
+    return juce::Result::ok ();
+}
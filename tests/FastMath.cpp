@@ -0,0 +1,78 @@
+#include <Utility/FastMath.h>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+/** The largest difference between approximation and reference, over count points spread evenly in [start, end]. */
+template <typename T, typename Approximation, typename Reference>
+double getMaxError (Approximation approximation, Reference reference, double start, double end, int count = 1'000'000)
+{
+    auto maxError { 0. };
+    for (int i = 0; i <= count; ++i)
+    {
+        //the reference gets the same rounded x as the approximation
+        const auto x { static_cast<T> (start + (end - start) * i / count) };
+        maxError = std::max (maxError, std::abs (static_cast<double> (approximation (x)) - reference (static_cast<double> (x))));
+    }
+
+    return maxError;
+}
+}
+
+TEMPLATE_TEST_CASE ("FastMath approximations stay within their documented bounds", "[fastmath]", float, double)
+{
+    using T = TestType;
+    using namespace FastMath;
+    constexpr auto isFloat { std::is_same_v<T, float> };
+
+    SECTION ("sin")
+    {
+        const auto error { getMaxError<T> (Approximations::sin<T>, [] (double x) { return std::sin (x); }, -10, 10) };
+        CHECK (error < (isFloat ? 3e-7 : 6e-8));
+
+        //doubles keep their precision over a lot more periods
+        if constexpr (! isFloat)
+            CHECK (getMaxError<T> (Approximations::sin<T>, [] (double x) { return std::sin (x); }, -1e4, 1e4) < 6e-8);
+    }
+
+    SECTION ("tanh")
+    {
+        //that includes the clamp to [-5, 5]
+        CHECK (getMaxError<T> (Approximations::tanh<T>, [] (double x) { return std::tanh (x); }, -20, 20) < 1.1e-4);
+    }
+
+    SECTION ("exp2")
+    {
+        const auto relativeError = [] (T x) { return static_cast<double> (Approximations::exp2 (x)) / std::exp2 (static_cast<double> (x)); };
+        CHECK (getMaxError<T> (relativeError, [] (double) { return 1.; }, -126, 127.999) < (isFloat ? 2e-7 : 8e-8));
+    }
+
+    SECTION ("log2")
+    {
+        CHECK (getMaxError<T> (Approximations::log2<T>, [] (double x) { return std::log2 (x); }, .5, 2) < (isFloat ? 2e-7 : 2e-9));
+
+        //further out, relative to the result
+        auto maxError { 0. };
+        for (auto x { 1e-30 }; x < 1e30; x *= 1.001)
+        {
+            const auto reference { std::log2 (static_cast<double> (static_cast<T> (x))) };
+            maxError = std::max (maxError, std::abs (Approximations::log2 (static_cast<T> (x)) - reference) / std::max (1., std::abs (reference)));
+        }
+        CHECK (maxError < (isFloat ? 2e-7 : 2e-9));
+    }
+
+    SECTION ("exact where it matters")
+    {
+        //whole octaves are as close to the exact powers of 2 as anywhere else, so octaves stay in tune
+        for (int octave = -10; octave <= 10; ++octave)
+        {
+            const auto reference { std::exp2 (static_cast<double> (octave)) };
+            CHECK (std::abs (static_cast<double> (Approximations::exp2 (T (octave))) / reference - 1.) < (isFloat ? 2e-7 : 8e-8));
+        }
+
+        CHECK (Approximations::log2 (T (1)) == T (0));
+        CHECK (Approximations::sin (T (0)) == T (0));
+        CHECK (Approximations::tanh (T (0)) == T (0));
+    }
+}
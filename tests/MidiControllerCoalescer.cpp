@@ -0,0 +1,133 @@
+#include <DSP/MidiControllerCoalescer.h>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+struct Event
+{
+    int position;
+    juce::MidiMessage message;
+};
+
+std::vector<Event> coalesce (MidiControllerCoalescer& coalescer, const std::vector<Event>& events, int numSamples, int windowPosition)
+{
+    juce::MidiBuffer buffer;
+    for (const auto& event : events)
+        buffer.addEvent (event.message, event.position);
+
+    coalescer.process (buffer, numSamples, windowPosition);
+
+    std::vector<Event> result;
+    for (const auto metadata : buffer)
+        result.push_back ({ metadata.samplePosition, metadata.getMessage () });
+
+    return result;
+}
+
+juce::MidiMessage modWheel (int value) { return juce::MidiMessage::controllerEvent (1, 1, value); }
+}
+
+TEST_CASE ("MidiControllerCoalescer", "[midi]")
+{
+    MidiControllerCoalescer coalescer;
+    coalescer.prepare (64);
+
+    SECTION ("only the last value of a window is kept, on its boundary")
+    {
+        const auto result { coalesce (coalescer, { { 3, modWheel (10) }, { 10, modWheel (20) }, { 40, modWheel (30) } }, 256, 0) };
+
+        REQUIRE (result.size () == 1);
+        CHECK (result[0].position == 64);
+        CHECK (result[0].message.getControllerValue () == 30);
+    }
+
+    SECTION ("windows line up with the quantum, not with the block")
+    {
+        const auto result { coalesce (coalescer, { { 10, modWheel (10) }, { 50, modWheel (20) } }, 256, 20) };
+
+        REQUIRE (result.size () == 2);
+        CHECK (result[0].position == 44);
+        CHECK (result[0].message.getControllerValue () == 10);
+        CHECK (result[1].position == 108);
+        CHECK (result[1].message.getControllerValue () == 20);
+    }
+
+    SECTION ("pending controllers go right before notes, which keep their position")
+    {
+        const auto noteOn { juce::MidiMessage::noteOn (1, 60, (juce::uint8) 100) };
+        const auto result { coalesce (coalescer, { { 3, modWheel (5) }, { 10, noteOn }, { 20, modWheel (7) } }, 256, 0) };
+
+        REQUIRE (result.size () == 3);
+        CHECK ((result[0].position == 10 && result[0].message.getControllerValue () == 5));
+        CHECK ((result[1].position == 10 && result[1].message.isNoteOn ()));
+        CHECK ((result[2].position == 64 && result[2].message.getControllerValue () == 7));
+    }
+
+    SECTION ("values at the end of a block carry over to the boundary in the next one")
+    {
+        auto result { coalesce (coalescer, { { 70, modWheel (42) } }, 100, 0) };
+        CHECK (result.empty ());
+        CHECK (coalescer.getNumPendingControllers () == 1);
+
+        //the next block starts 100 % 64 = 36 samples into the window
+        result = coalesce (coalescer, {}, 100, 36);
+        REQUIRE (result.size () == 1);
+        CHECK (result[0].position == 28);
+        CHECK (result[0].message.getControllerValue () == 42);
+        CHECK (coalescer.getNumPendingControllers () == 0);
+    }
+
+    SECTION ("a block starting on a boundary emits what was carried over first")
+    {
+        coalesce (coalescer, { { 70, modWheel (42) } }, 128, 0);
+
+        //the window ended exactly with the block
+        CHECK (coalescer.getNumPendingControllers () == 1);
+
+        const auto result { coalesce (coalescer, {}, 64, 0) };
+        REQUIRE (result.size () == 1);
+        CHECK (result[0].position == 0);
+    }
+
+    SECTION ("more than 32 different controllers in a window flush the first 32 early")
+    {
+        //32 different continuous controllers on channel 1, then one on channel 2
+        std::vector<int> numbers;
+        for (int number = 1; numbers.size () < 32; ++number)
+            if (number != 6 && number != 32 && number != 38)
+                numbers.push_back (number);
+
+        std::vector<Event> events;
+        for (int i = 0; i < 33; ++i)
+            events.push_back ({ 5 + i, juce::MidiMessage::controllerEvent (1 + i / 32, numbers[(size_t) i % 32], i) });
+
+        const auto result { coalesce (coalescer, events, 256, 0) };
+
+        REQUIRE (result.size () == 33);
+        for (size_t i = 0; i < 32; ++i)
+        {
+            CHECK (result[i].position == 5 + 32);
+            CHECK (result[i].message.getControllerValue () == (int) i);
+        }
+
+        CHECK (result[32].position == 64);
+        CHECK (result[32].message.getChannel () == 2);
+    }
+
+    SECTION ("bank select and data entry pairs pass through, in order")
+    {
+        const auto controller = [] (int number, int value) { return juce::MidiMessage::controllerEvent (1, number, value); };
+        const std::vector<Event> events { { 3, controller (0, 1) }, { 4, controller (32, 5) }, { 10, controller (0, 2) }, { 11, controller (32, 7) },
+                                          { 20, controller (6, 3) }, { 21, controller (38, 4) } };
+
+        const auto result { coalesce (coalescer, events, 256, 0) };
+
+        REQUIRE (result.size () == events.size ());
+        for (size_t i = 0; i < events.size (); ++i)
+        {
+            CHECK (result[i].position == events[i].position);
+            CHECK (result[i].message.getControllerNumber () == events[i].message.getControllerNumber ());
+            CHECK (result[i].message.getControllerValue () == events[i].message.getControllerValue ());
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#include <Utility/TuningTable.h>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+constexpr auto middleC { 261.6255653005986 };
+
+/** True when the table plays note at the frequency, within what the float pitches and FastMath::exp2() allow. */
+bool playsAt (const TuningTable& tuning, float note, double frequency)
+{
+    return std::abs (tuning.getFrequency (note) / frequency - 1.) < 1e-5;
+}
+
+/** The 12-TET scale as a .scl file, with its notes in cents. */
+juce::String getEqualTemperamentScale ()
+{
+    juce::String scl { "12 tone equal\n12\n" };
+    for (int i = 1; i <= 12; ++i)
+        scl << juce::String (i * 100) << ".0\n";
+
+    return scl;
+}
+}
+
+TEST_CASE ("Scala scales are parsed", "[tuning]")
+{
+    TuningTable tuning;
+
+    SECTION ("ratios and cents give the same pitches")
+    {
+        //without a keyboard mapping, middle C plays the first degree, and each key above it the next one
+        REQUIRE (tuning.loadScala ("fifths\n2\n3/2\n2\n").wasOk ());
+        REQUIRE (tuning.update ());
+        const auto ratioFifth { tuning.getFrequency (61) }, ratioOctave { tuning.getFrequency (62) };
+
+        REQUIRE (tuning.loadScala ("fifths\n2\n701.955000865\n1200.\n").wasOk ());
+        REQUIRE (tuning.update ());
+
+        CHECK (playsAt (tuning, 60, middleC));
+        CHECK (playsAt (tuning, 61, middleC * 3 / 2));
+        CHECK (playsAt (tuning, 62, middleC * 2));
+        CHECK (playsAt (tuning, 63, middleC * 3));
+        CHECK (playsAt (tuning, 59, middleC * 3 / 4));
+        CHECK (playsAt (tuning, 58, middleC / 2));
+
+        CHECK (playsAt (tuning, 61, ratioFifth));
+        CHECK (playsAt (tuning, 62, ratioOctave));
+    }
+
+    SECTION ("comments are skipped, and anything after a value is ignored")
+    {
+        REQUIRE (tuning.loadScala ("! fifths.scl\n!\nfifths\n 2 notes\n! the fifth\n3/2 a fifth\n 2/1\n").wasOk ());
+        REQUIRE (tuning.update ());
+
+        CHECK (playsAt (tuning, 61, middleC * 3 / 2));
+        CHECK (playsAt (tuning, 62, middleC * 2));
+    }
+
+    SECTION ("the description line can be blank")
+    {
+        REQUIRE (tuning.loadScala ("! blank.scl\n\n2\n3/2\n2/1\n").wasOk ());
+        REQUIRE (tuning.update ());
+
+        CHECK (playsAt (tuning, 61, middleC * 3 / 2));
+    }
+
+    SECTION ("keys marked with an x play the closest mapped key below them")
+    {
+        const juce::String kbm { "! no black keys\n12\n0\n127\n60\n69\n440.0\n12\n0\nx\n2\nx\n4\n5\nx\n7\nx\n9\nx\n11\n" };
+        REQUIRE (tuning.loadScala (getEqualTemperamentScale (), kbm).wasOk ());
+        REQUIRE (tuning.update ());
+
+        CHECK (playsAt (tuning, 69, 440.));
+        CHECK (playsAt (tuning, 60, middleC));
+        CHECK (playsAt (tuning, 61, middleC));
+        CHECK (playsAt (tuning, 62, 440. * std::exp2 (-7 / 12.)));
+        CHECK (playsAt (tuning, 70, 440.));
+        CHECK (playsAt (tuning, 73, middleC * 2));
+        CHECK (playsAt (tuning, 49, middleC / 2));
+    }
+
+    SECTION ("the formal octave is the degree the mapping repeats at")
+    {
+        //7 keys mapped to the white keys of a 12-TET scale, so the octave is 7 keys up, and 12 degrees up
+        const juce::String kbm { "7\n0\n127\n60\n60\n261.6255653005986\n12\n0\n2\n4\n5\n7\n9\n11\n" };
+        REQUIRE (tuning.loadScala (getEqualTemperamentScale (), kbm).wasOk ());
+        REQUIRE (tuning.update ());
+
+        CHECK (playsAt (tuning, 60, middleC));
+        CHECK (playsAt (tuning, 61, middleC * std::exp2 (2 / 12.)));
+        CHECK (playsAt (tuning, 66, middleC * std::exp2 (11 / 12.)));
+        CHECK (playsAt (tuning, 67, middleC * 2));
+        CHECK (playsAt (tuning, 53, middleC / 2));
+
+        //a formal octave of 0 is the whole scale
+        const juce::String wholeScale { "7\n0\n127\n60\n60\n261.6255653005986\n0\n0\n2\n4\n5\n7\n9\n11\n" };
+        REQUIRE (tuning.loadScala (getEqualTemperamentScale (), wholeScale).wasOk ());
+        REQUIRE (tuning.update ());
+
+        CHECK (playsAt (tuning, 67, middleC * 2));
+    }
+
+    SECTION ("notes outside of the table play its ends")
+    {
+        REQUIRE (tuning.loadScala (getEqualTemperamentScale ()).wasOk ());
+        REQUIRE (tuning.update ());
+
+        CHECK (tuning.getFrequency (-5.f) == tuning.getFrequency (0.f));
+        CHECK (tuning.getFrequency (140.f) == tuning.getFrequency (127.f));
+        CHECK (tuning.getFrequency (126.5f) < tuning.getFrequency (127.f));
+    }
+
+    SECTION ("malformed files are rejected, and the previous tuning is kept")
+    {
+        REQUIRE (tuning.loadScala ("fifths\n2\n3/2\n2\n").wasOk ());
+        REQUIRE (tuning.update ());
+
+        const juce::StringArray malformedScales {
+            "",
+            "no count\n",
+            "not a count\nfive\n",
+            "too few notes\n3\n3/2\n2/1\n",
+            "a bad ratio\n2\n3/x\n2/1\n",
+            "a ratio with a period\n2\n1.5/2\n2/1\n",
+            "a zero ratio\n2\n0/1\n2/1\n",
+            "no notes\n0\n"
+        };
+
+        for (const auto& scl : malformedScales)
+        {
+            INFO (scl.toStdString ());
+            CHECK (tuning.loadScala (scl).failed ());
+        }
+
+        const auto fifths { "fifths\n2\n3/2\n2\n" };
+        CHECK (tuning.loadScala (fifths, "12\n0\n127\n60\n").failed ());
+        CHECK (tuning.loadScala (fifths, "12\n0\n127\n60\n69\n0\n2\n").failed ());
+        CHECK (tuning.loadScala (fifths, "2\n0\n127\n60\n61\n440.0\n2\n0\nx\n").failed ());
+        CHECK (tuning.loadScala (fifths, "1\n0\n127\n60\n60\n440.0\n2\nx\n").failed ());
+        CHECK (tuning.loadScala ("far out\n1\n100000.\n").failed ());
+
+        CHECK_FALSE (tuning.update ());
+        CHECK (playsAt (tuning, 61, middleC * 3 / 2));
+        CHECK (playsAt (tuning, 62, middleC * 2));
+    }
+}
@@ -0,0 +1,50 @@
+#include <DSP/ProPhatProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+void setParameter (ProPhatProcessor& processor, const juce::ParameterID& id, float value)
+{
+    auto* parameter { processor.state.getParameter (id.getParamID ()) };
+    parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+}
+}
+
+TEST_CASE ("Unison stacks above the sample rate stay bounded", "[oscillators]")
+{
+    using namespace ProPhatParameterIds;
+
+    //the highest note, transposed all the way up and bent up, puts the top copies of the stack way above the sample rate
+    ProPhatProcessor processor;
+    setParameter (processor, osc1FreqID, (float) Constants::midiNoteRange.end);
+    setParameter (processor, osc2FreqID, (float) Constants::midiNoteRange.end);
+    setParameter (processor, unisonVoicesID, (float) Constants::unisonVoicesRange.end);
+    setParameter (processor, unisonDetuneID, Constants::sliderRange.end);
+
+    processor.prepareToPlay (48000., 256);
+
+    juce::MidiBuffer midi;
+    midi.addEvent (juce::MidiMessage::pitchWheel (1, 16383), 0);
+    midi.addEvent (juce::MidiMessage::noteOn (1, 127, (juce::uint8) 127), 0);
+
+    juce::AudioBuffer<float> buffer (2, 256);
+    auto maxLevel { 0.f };
+    auto allFinite { true };
+    for (int i = 0; i < 20; ++i)
+    {
+        processor.processBlock (buffer, midi);
+        midi.clear ();
+
+        for (int c = 0; c < buffer.getNumChannels (); ++c)
+            for (int s = 0; s < buffer.getNumSamples (); ++s)
+            {
+                const auto sample { buffer.getSample (c, s) };
+                allFinite = allFinite && std::isfinite (sample);
+                maxLevel = juce::jmax (maxLevel, std::abs (sample));
+            }
+    }
+
+    CHECK (allFinite);
+    CHECK (maxLevel > 0.f);
+    CHECK (maxLevel < 4.f);
+}
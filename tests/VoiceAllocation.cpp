@@ -0,0 +1,129 @@
+#include <DSP/ProPhatProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+constexpr auto sampleRate { 48000. };
+constexpr auto blockSize { 256 };
+
+void setParameter (ProPhatProcessor& processor, const juce::ParameterID& id, float value)
+{
+    auto* parameter { processor.state.getParameter (id.getParamID ()) };
+    parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+}
+
+/** Renders numBlocks blocks, with midi in the first one. */
+void render (ProPhatProcessor& processor, int numBlocks, juce::MidiBuffer midi = {})
+{
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    for (int i = 0; i < numBlocks; ++i)
+    {
+        processor.processBlock (buffer, midi);
+        midi.clear ();
+    }
+}
+
+int secondsToBlocks (double seconds) { return (int) std::ceil (seconds * sampleRate / blockSize); }
+}
+
+TEST_CASE ("Releasing voices are retired under the threshold", "[voices]")
+{
+    //with a release this long, the default threshold keeps the voice playing until the very end
+    const auto releaseSeconds { 3.f };
+    const auto isActiveAfterRelease = [releaseSeconds] (std::optional<float> thresholdDb)
+    {
+        ProPhatProcessor processor;
+        setParameter (processor, ProPhatParameterIds::ampReleaseID, releaseSeconds);
+        if (thresholdDb)
+            processor.setVoiceRetireThreshold (*thresholdDb);
+
+        processor.prepareToPlay (sampleRate, blockSize);
+
+        juce::MidiBuffer midi;
+        midi.addEvent (juce::MidiMessage::noteOn (1, 60, (juce::uint8) 100), 0);
+        render (processor, secondsToBlocks (.2), midi);
+        REQUIRE (processor.getNumActiveVoices () == 1);
+
+        midi.addEvent (juce::MidiMessage::noteOff (1, 60), 0);
+        render (processor, secondsToBlocks (.95 * releaseSeconds), midi);
+        return processor.getNumActiveVoices () == 1;
+    };
+
+    CHECK (isActiveAfterRelease ({}));
+    CHECK_FALSE (isActiveAfterRelease (-20.f));
+}
+
+TEST_CASE ("Note-ons flooding in during mass kills are backlogged", "[voices]")
+{
+    ProPhatProcessor processor;
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    const auto noteOns = [] (int firstNote, int numNotes)
+    {
+        juce::MidiBuffer midi;
+        for (int note = firstNote; note < firstNote + numNotes; ++note)
+            midi.addEvent (juce::MidiMessage::noteOn (1, note, (juce::uint8) 100), 0);
+        return midi;
+    };
+
+    //fill all the voices, then steal every one of them so they're all being killed
+    render (processor, 1, noteOns (20, Constants::numVoices));
+    REQUIRE (processor.getNumActiveVoices () == Constants::numVoices);
+
+    auto flood { noteOns (40, Constants::numVoices) };
+
+    SECTION ("backlogged notes start within the maximum latency")
+    {
+        flood.addEvents (noteOns (60, Constants::numVoices), 0, -1, 0);
+
+        //render just enough to get to the maximum latency, in small blocks so the backlog is checked often
+        juce::AudioBuffer<float> buffer (2, 16);
+        const auto maxLatencySamples { (int) (sampleRate * Constants::maxNoteOnLatencySeconds) };
+        for (int pos = 0; pos < maxLatencySamples; pos += buffer.getNumSamples ())
+        {
+            processor.processBlock (buffer, flood);
+            flood.clear ();
+
+            //the first flood stole all the voices, so the second one had to wait
+            if (pos == 0)
+                CHECK (processor.getNumPendingNoteOns () == Constants::numVoices);
+        }
+
+        CHECK (processor.getNumPendingNoteOns () == 0);
+        CHECK (processor.getNumDroppedNoteOns () == 0);
+    }
+
+    SECTION ("new note-ons queue behind the backlog")
+    {
+        //more notes wait than there are voices
+        flood.addEvents (noteOns (60, Constants::maxPendingNoteOns), 0, -1, 0);
+
+        juce::AudioBuffer<float> buffer (2, 64);
+        for (int pos = 0; pos + buffer.getNumSamples () < Constants::killRampSamples; pos += buffer.getNumSamples ())
+        {
+            processor.processBlock (buffer, flood);
+            flood.clear ();
+        }
+        REQUIRE (processor.getNumPendingNoteOns () == Constants::maxPendingNoteOns);
+
+        //the kills end within this block, so the backlog starts right before the new note, and steals all the voices again
+        juce::MidiBuffer lateNote;
+        lateNote.addEvent (juce::MidiMessage::noteOn (1, 100, (juce::uint8) 100), buffer.getNumSamples () - 1);
+        processor.processBlock (buffer, lateNote);
+
+        CHECK (processor.getNumPendingNoteOns () == Constants::maxPendingNoteOns - Constants::numVoices + 1);
+        CHECK (processor.getNumDroppedNoteOns () == 0);
+    }
+
+    SECTION ("note-ons that don't fit in the backlog are dropped and counted")
+    {
+        const auto numOverflowing { 3 };
+        flood.addEvents (noteOns (60, Constants::maxPendingNoteOns + numOverflowing), 0, -1, 0);
+
+        juce::AudioBuffer<float> buffer (2, 16);
+        processor.processBlock (buffer, flood);
+
+        CHECK (processor.getNumPendingNoteOns () == Constants::maxPendingNoteOns);
+        CHECK (processor.getNumDroppedNoteOns () == numOverflowing);
+    }
+}